@@ -0,0 +1,156 @@
+#include "Acceptor.hpp"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <sched.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+/**
+ * openListener
+ * Creates, binds and starts a listening socket.
+ *
+ * @param port The port to bind to on all interfaces.
+ * @param backlog The length of the pending-connection queue.
+ * @param reusePort Whether to set SO_REUSEPORT so several sockets can share the port.
+ * @return The listening socket.
+ * @throws runtime_error if any step fails.
+ */
+int openListener(int port, int backlog, bool reusePort)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        throw runtime_error(string("Socket creation failed: ") + strerror(errno));
+
+    int opt = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) ||
+        (reusePort && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt))))
+    {
+        string error = strerror(errno);
+        close(fd);
+        throw runtime_error("setsockopt failed: " + error);
+    }
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(port);
+    if (bind(fd, (sockaddr *)&address, sizeof(address)) < 0 || listen(fd, backlog) < 0)
+    {
+        string error = strerror(errno);
+        close(fd);
+        throw runtime_error("Bind/listen failed: " + error);
+    }
+    return fd;
+}
+
+/**
+ * ShardedAcceptor
+ * Creates one shard per CPU in the process affinity mask, each with its own listener,
+ * event loop and worker pool. The configured thread count is split over the shards.
+ *
+ * @param config The server settings (port, backlog, threads, adaptive, I/O backend).
+ * @param handler Called for every accepted client.
+ * @throws runtime_error if a listener cannot be created.
+ */
+ShardedAcceptor::ShardedAcceptor(const ServerConfig &config, Handler handler) : handler(std::move(handler))
+{
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    vector<int> cpus;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        {
+            if (CPU_ISSET(cpu, &allowed))
+                cpus.push_back(cpu);
+        }
+    }
+    if (cpus.empty())
+        cpus.push_back(0);
+
+    // Blocking sessions still need a loop to accept on
+    IoBackendKind loopKind = config.ioBackend == IoBackendKind::Blocking ? IoBackendKind::Epoll : config.ioBackend;
+    size_t threadsPerShard = max<size_t>((config.threads + cpus.size() - 1) / cpus.size(), 1);
+    try
+    {
+        for (int cpu : cpus)
+        {
+            auto shard = make_unique<Shard>();
+            shard->cpu = cpu;
+            shard->listenFd = openListener(config.port, config.backlog, true);
+            shard->loop = make_unique<EventLoop>(loopKind);
+            shard->pool = make_unique<WorkStealingPool>(threadsPerShard, config.adaptive, cpu);
+            shards.push_back(std::move(shard));
+        }
+    }
+    catch (...)
+    {
+        for (auto &shard : shards)
+            close(shard->listenFd);
+        throw;
+    }
+}
+
+ShardedAcceptor::~ShardedAcceptor()
+{
+    stop();
+    for (auto &shard : shards)
+    {
+        if (shard->thread.joinable())
+            shard->thread.join();
+        close(shard->listenFd);
+    }
+}
+
+// Function: run
+// Starts the event loop of every shard and waits until all of them have stopped.
+void ShardedAcceptor::run()
+{
+    for (auto &shard : shards)
+    {
+        Shard *s = shard.get();
+        s->thread = thread([this, s]()
+                           { runShard(s); });
+    }
+    for (auto &shard : shards)
+    {
+        if (shard->thread.joinable())
+            shard->thread.join();
+    }
+}
+
+// Function: stop
+// Stops every shard's event loop; safe to call from any thread.
+void ShardedAcceptor::stop()
+{
+    for (auto &shard : shards)
+        shard->loop->stop();
+}
+
+/**
+ * runShard
+ * Pins the calling thread to the shard's CPU and runs the shard's event loop, which
+ * accepts on the shard's own listener.
+ *
+ * @param shard The shard to run.
+ */
+void ShardedAcceptor::runShard(Shard *shard)
+{
+    if (!pinCurrentThread(shard->cpu))
+        cerr << "Could not pin shard to CPU " << shard->cpu << endl;
+
+    shard->loop->listen(shard->listenFd, [this, shard](int client)
+                        {
+        if (client < 0)
+        {
+            cerr << "Accept failed: " << strerror(-client) << endl;
+            return;
+        }
+        handler(client, *shard->loop, *shard->pool); });
+    shard->loop->run();
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "EventLoop.hpp"
+#include "ServerConfig.hpp"
+#include "WorkStealingPool.hpp"
+
+// Opens a TCP listening socket on all interfaces; throws runtime_error on failure
+int openListener(int port, int backlog, bool reusePort);
+
+// this is a class that opens one SO_REUSEPORT listener per allowed CPU. Every shard runs its own
+// EventLoop and its own worker set, all pinned to that CPU, so the kernel spreads incoming
+// connections over the cores instead of funnelling them through one accept thread.
+class ShardedAcceptor
+{
+public:
+    // Called on the shard's loop thread for every new client
+    using Handler = std::function<void(int clientSocket, EventLoop &shardLoop, WorkStealingPool &shardPool)>;
+
+    ShardedAcceptor(const ServerConfig &config, Handler handler);
+    ~ShardedAcceptor();
+    void run();  // Blocks until stop() is called
+    void stop(); // Safe to call from any thread, including a shard's workers
+    size_t shardCount() const { return shards.size(); }
+
+private:
+    struct Shard
+    {
+        int cpu;
+        int listenFd = -1;
+        std::unique_ptr<EventLoop> loop;
+        std::unique_ptr<WorkStealingPool> pool;
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    Handler handler;
+
+    void runShard(Shard *shard);
+};
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+
+// this is a class for the scratch memory of one connection's requests: a monotonic arena
+// over a buffer the connection keeps. Allocating is a pointer bump, freeing is a no-op, and
+// reset() drops everything the last request allocated at once. Requests that outgrow the
+// buffer continue in blocks from the heap, which reset() hands back.
+class RequestArena
+{
+public:
+    static constexpr size_t INITIAL_SIZE = 8 * 1024;
+
+    // The buffer is only allocated once the connection sends its first request
+    std::pmr::memory_resource *resource()
+    {
+        if (!arena)
+        {
+            buffer = std::make_unique<std::byte[]>(INITIAL_SIZE);
+            arena.emplace(buffer.get(), INITIAL_SIZE);
+        }
+        return &*arena;
+    }
+
+    // Everything allocated from the arena must be destroyed or emptied first
+    void reset()
+    {
+        if (arena)
+            arena->release();
+    }
+
+private:
+    std::unique_ptr<std::byte[]> buffer;
+    std::optional<std::pmr::monotonic_buffer_resource> arena;
+};
@@ -0,0 +1,86 @@
+#pragma once
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// this is a class for a packed square bit matrix: one bit per cell, 64 cells per word, every row
+// starting on a word of its own. Graph keeps one next to its weights to mark the edges, so rows
+// can be counted with popcount and walked with count-trailing-zeros, skipping 64 empty cells
+// per word instead of testing each of them.
+class BitMatrix
+{
+public:
+    static const size_t WORD_BITS = 64;
+
+    BitMatrix() = default;
+    BitMatrix(size_t rows, size_t cols)
+        : rowCount(rows), colCount(cols), rowWords((cols + WORD_BITS - 1) / WORD_BITS), words(rows * rowWords, 0)
+    {
+    }
+
+    size_t rows() const { return rowCount; }
+    size_t cols() const { return colCount; }
+    size_t bytes() const { return words.size() * sizeof(uint64_t); }
+
+    bool test(size_t row, size_t col) const
+    {
+        return (words[row * rowWords + col / WORD_BITS] >> (col % WORD_BITS)) & 1;
+    }
+
+    void set(size_t row, size_t col, bool value)
+    {
+        uint64_t &word = words[row * rowWords + col / WORD_BITS];
+        uint64_t bit = uint64_t(1) << (col % WORD_BITS);
+        word = value ? word | bit : word & ~bit;
+    }
+
+    // Counts the set bits in columns [from, to) of a row
+    int count(size_t row, size_t from, size_t to) const
+    {
+        int total = 0;
+        forEachWord(row, from, to, [&](size_t, uint64_t word)
+                    { total += std::popcount(word); });
+        return total;
+    }
+
+    // Calls visit(col) for every set bit in columns [from, to) of a row, in increasing order
+    template <typename Visitor>
+    void forEach(size_t row, size_t from, size_t to, Visitor &&visit) const
+    {
+        forEachWord(row, from, to, [&](size_t base, uint64_t word)
+                    {
+            while (word)
+            {
+                visit(base + std::countr_zero(word));
+                word &= word - 1; // Clear the lowest set bit
+            } });
+    }
+
+private:
+    size_t rowCount = 0;
+    size_t colCount = 0;
+    size_t rowWords = 0;
+    std::vector<uint64_t> words;
+
+    // Hands every non-zero word of columns [from, to) to visit, with the column of its bit 0;
+    // the first and last words are masked to the range
+    template <typename Visitor>
+    void forEachWord(size_t row, size_t from, size_t to, Visitor &&visit) const
+    {
+        if (from >= to)
+            return;
+        const uint64_t *line = words.data() + row * rowWords;
+        size_t first = from / WORD_BITS, last = (to - 1) / WORD_BITS;
+        for (size_t w = first; w <= last; w++)
+        {
+            uint64_t word = line[w];
+            if (w == first)
+                word &= ~uint64_t(0) << (from % WORD_BITS);
+            if (w == last && to % WORD_BITS != 0)
+                word &= ~uint64_t(0) >> (WORD_BITS - to % WORD_BITS);
+            if (word)
+                visit(w * WORD_BITS, word);
+        }
+    }
+};
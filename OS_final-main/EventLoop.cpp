@@ -0,0 +1,389 @@
+#include "EventLoop.hpp"
+#include <cerrno>
+#include <future>
+#include <iostream>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using namespace std;
+
+EventLoop::EventLoop(IoBackendKind kind) : backend(makeIoBackend(kind))
+{
+}
+
+/**
+ * run
+ * The loop itself: runs the posted operations, which queue their submissions in the
+ * backend, then submits them all at once and dispatches the completions.
+ */
+void EventLoop::run()
+{
+    vector<function<void()>> batch;
+    vector<IoEvent> events;
+    loopThread = this_thread::get_id();
+    while (true)
+    {
+        {
+            lock_guard<mutex> lock(opsMutex);
+            if (stopping)
+                return;
+            batch.swap(ops);
+        }
+        if (!batch.empty())
+        {
+            for (auto &op : batch)
+                op();
+            batch.clear();
+            continue; // The ops may have resumed sessions that posted more; run those before blocking
+        }
+
+        backend->wait(events);
+        for (auto &event : events)
+        {
+            switch (event.type)
+            {
+            case IoEvent::Accept:
+            {
+                auto it = acceptors.find(event.fd);
+                if (it != acceptors.end())
+                    it->second(event.result);
+                break;
+            }
+            case IoEvent::Recv:
+            {
+                auto it = conns.find(event.fd);
+                if (it == conns.end())
+                    break;
+                if (event.result > 0)
+                    it->second.inbox += event.data;
+                else
+                    it->second.status = event.result;
+                deliver(event.fd, it->second);
+                break;
+            }
+            case IoEvent::Send:
+            {
+                auto it = writers.find(event.token);
+                if (it != writers.end())
+                {
+                    auto done = std::move(it->second);
+                    writers.erase(it);
+                    done(event.result, std::move(event.parts));
+                }
+                break;
+            }
+            }
+        }
+        events.clear();
+    }
+}
+
+void EventLoop::stop()
+{
+    {
+        lock_guard<mutex> lock(opsMutex);
+        stopping = true;
+    }
+    backend->wake();
+}
+
+void EventLoop::post(function<void()> op)
+{
+    {
+        lock_guard<mutex> lock(opsMutex);
+        ops.push_back(std::move(op));
+    }
+    if (!inLoopThread()) // The loop drains ops before it waits again anyway
+        backend->wake();
+}
+
+void EventLoop::listen(int listenFd, function<void(int)> onAccept)
+{
+    post([this, listenFd, onAccept]()
+         {
+        acceptors[listenFd] = onAccept;
+        backend->watchAccept(listenFd); });
+}
+
+void EventLoop::attach(int fd)
+{
+    post([this, fd]()
+         {
+        conns[fd] = Conn();
+        backend->watchRecv(fd); });
+}
+
+// Hands the buffered data (or the end of the stream) to a waiting reader
+void EventLoop::deliver(int fd, Conn &conn)
+{
+    (void)fd;
+    if (!conn.reader || (conn.inbox.empty() && conn.status > 0))
+        return;
+    auto reader = std::move(conn.reader);
+    conn.reader = nullptr;
+    if (!conn.inbox.empty())
+    {
+        string data;
+        data.swap(conn.inbox);
+        int size = (int)data.size();
+        reader(size, std::move(data));
+    }
+    else
+    {
+        reader(conn.status, string());
+    }
+}
+
+void EventLoop::read(int fd, function<void(int, string)> done)
+{
+    post([this, fd, done]()
+         {
+        auto it = conns.find(fd);
+        if (it == conns.end())
+        {
+            done(-EBADF, string());
+            return;
+        }
+        it->second.reader = done;
+        deliver(fd, it->second); });
+}
+
+void EventLoop::write(int fd, vector<string> parts, function<void(int, vector<string>)> done)
+{
+    auto shared = make_shared<vector<string>>(std::move(parts));
+    post([this, fd, shared, done]()
+         {
+        uint64_t token = nextToken++;
+        writers[token] = done;
+        backend->send(fd, std::move(*shared), token); });
+}
+
+void EventLoop::detach(int fd)
+{
+    post([this, fd]()
+         {
+        auto it = conns.find(fd);
+        if (it != conns.end())
+        {
+            if (it->second.reader)
+                it->second.reader(-ECANCELED, string());
+            conns.erase(it);
+        }
+        backend->unwatch(fd);
+        ::close(fd); });
+}
+
+// Waits until a socket in nonblocking mode (or with a timeout) can make progress again
+static void waitReady(int fd, short events)
+{
+    pollfd entry{fd, events, 0};
+    while (poll(&entry, 1, -1) < 0 && errno == EINTR)
+    {
+    }
+}
+
+void Session::promise_type::unhandled_exception()
+{
+    try
+    {
+        throw;
+    }
+    catch (const exception &e)
+    {
+        cerr << "Session ended by an exception: " << e.what() << endl;
+    }
+}
+
+/**
+ * Receive::await_ready
+ * Without an event loop this does one blocking read() and never suspends.
+ * With one, the session suspends until the loop has data buffered or the stream ends.
+ */
+bool Connection::Receive::await_ready()
+{
+    if (conn.loop)
+        return false;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = ::read(conn.socket, buffer, sizeof(buffer))) < 0)
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            waitReady(conn.socket, POLLIN);
+        else if (errno != EINTR)
+            break;
+    }
+    ok = n > 0;
+    if (ok)
+        message.assign(buffer, n);
+    return true;
+}
+
+void Connection::Receive::await_suspend(coroutine_handle<> session)
+{
+    conn.loop->read(conn.socket, [this, session](int res, string data)
+                    {
+        message = std::move(data);
+        ok = res > 0;
+        session.resume(); });
+}
+
+Connection::Send Connection::send(string data)
+{
+    vector<string> parts;
+    parts.push_back(std::move(data));
+    return Send{*this, std::move(parts)};
+}
+
+/**
+ * Send::await_ready
+ * Without an event loop this sends every byte with blocking sendmsg() calls over all the
+ * parts at once, resuming after partial writes and EAGAIN, and never suspends.
+ */
+bool Connection::Send::await_ready()
+{
+    if (conn.loop)
+        return false;
+    static const size_t MAX_IOV = 64;
+    size_t part = 0, offset = 0;
+    ok = true;
+    while (ok && part < parts.size())
+    {
+        iovec iov[MAX_IOV];
+        size_t count = 0;
+        for (size_t i = part; i < parts.size() && count < MAX_IOV; i++, count++)
+        {
+            size_t skip = i == part ? offset : 0;
+            iov[count].iov_base = parts[i].data() + skip;
+            iov[count].iov_len = parts[i].size() - skip;
+        }
+        msghdr message{};
+        message.msg_iov = iov;
+        message.msg_iovlen = count;
+        ssize_t n = sendmsg(conn.socket, &message, MSG_NOSIGNAL);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            waitReady(conn.socket, POLLOUT); // Socket buffer full, resume where the write stopped
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        ok = n >= 0;
+        if (!ok)
+            break;
+
+        // Skip over what was sent; a partial write leaves offset inside parts[part]
+        size_t left = n;
+        while (part < parts.size() && left >= parts[part].size() - offset)
+        {
+            left -= parts[part].size() - offset;
+            part++;
+            offset = 0;
+        }
+        offset += left;
+    }
+    return true;
+}
+
+void Connection::Send::await_suspend(coroutine_handle<> session)
+{
+    conn.loop->write(conn.socket, std::move(parts), [this, session](int res, vector<string> sent)
+                     {
+        ok = res >= 0;
+        parts = std::move(sent);
+        session.resume(); });
+}
+
+bool Connection::Send::await_resume()
+{
+    if (source)
+        source->recycle(parts);
+    return ok;
+}
+
+// Without an event loop the session thread simply waits for the continuation
+bool Connection::Handoff::await_ready()
+{
+    if (conn.loop)
+        return false;
+    promise<void> finished;
+    start([&finished]()
+          { finished.set_value(); });
+    finished.get_future().wait();
+    return true;
+}
+
+void Connection::Handoff::await_suspend(coroutine_handle<> session)
+{
+    EventLoop *loop = conn.loop;
+    start([loop, session]()
+          { loop->post([session]()
+                       { session.resume(); }); });
+}
+
+void Connection::Handoff::await_resume() const
+{
+    if (error && *error)
+        rethrow_exception(*error);
+}
+
+/**
+ * handoff
+ * Starts work that finishes later, such as a change waiting for the log, off the loop thread.
+ * Blocking sessions already run on a worker of their own, so without an event loop start
+ * runs inline.
+ *
+ * @param pool The pool start runs on.
+ * @param start Calls resume once, when the work is done. If it throws instead, the session
+ *              resumes and co_await rethrows it; start must not throw after calling resume.
+ */
+Connection::Handoff Connection::handoff(WorkStealingPool &pool, function<void(function<void()> resume)> start)
+{
+    auto error = make_shared<exception_ptr>();
+    auto run = [start = std::move(start), error](function<void()> resume)
+    {
+        try
+        {
+            start(resume);
+        }
+        catch (...)
+        {
+            *error = current_exception();
+            resume();
+        }
+    };
+    if (!loop)
+        return Handoff{*this, run, error};
+    return Handoff{*this, [&pool, run](function<void()> resume)
+                   { pool.submit([run, resume]()
+                                 { run(resume); }); },
+                   error};
+}
+
+/**
+ * offload
+ * Moves CPU-bound work off the loop thread, inline without an event loop (see handoff).
+ *
+ * @param pool The pool the work runs on.
+ * @param work The work; the session resumes after it returned or threw, and co_await rethrows
+ *             what it threw, so a failed request is answered instead of never resuming.
+ */
+Connection::Handoff Connection::offload(WorkStealingPool &pool, function<void()> work)
+{
+    return handoff(pool, [work = std::move(work)](function<void()> resume)
+                   {
+                       work();
+                       resume();
+                   });
+}
+
+// Function: close
+// Closes the socket, through the loop if it is attached to one.
+void Connection::close()
+{
+    if (loop)
+        loop->detach(socket);
+    else
+        ::close(socket);
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "IoBackend.hpp"
+#include "Serializer.hpp"
+#include "WorkStealingPool.hpp"
+
+// this is a class that drives an IoBackend. Any thread may hand it operations; they are
+// queued and submitted together on the next iteration of run(), so one io_uring_enter
+// (or epoll_wait) covers the I/O of many connections. Callbacks run on the loop thread.
+class EventLoop
+{
+public:
+    explicit EventLoop(IoBackendKind kind);
+    const char *backendName() const { return backend->name(); }
+    void run();  // Blocks until stop()
+    void stop(); // Thread-safe
+
+    void post(std::function<void()> op); // Runs op on the loop thread
+    bool inLoopThread() const { return std::this_thread::get_id() == loopThread; }
+    void listen(int listenFd, std::function<void(int clientSocket)> onAccept);
+    void attach(int fd); // Starts buffering incoming data for fd
+    void read(int fd, std::function<void(int result, std::string data)> done); // Everything buffered, or the next data to arrive; result 0 on EOF
+    void write(int fd, std::vector<std::string> parts, std::function<void(int result, std::vector<std::string> parts)> done); // done gets the buffers back
+    void detach(int fd); // Stops all I/O on fd and closes it
+
+private:
+    struct Conn
+    {
+        std::string inbox;
+        int status = 1; // 1 while open, 0 after EOF, -errno after an error
+        std::function<void(int, std::string)> reader;
+    };
+
+    std::unique_ptr<IoBackend> backend;
+    std::mutex opsMutex;
+    std::vector<std::function<void()>> ops; // Posted by other threads, run by the loop
+    bool stopping = false;
+    std::thread::id loopThread; // Thread inside run()
+
+    // Loop thread only
+    std::unordered_map<int, Conn> conns;
+    std::unordered_map<int, std::function<void(int)>> acceptors;
+    std::unordered_map<uint64_t, std::function<void(int, std::vector<std::string>)>> writers;
+    uint64_t nextToken = 1;
+
+    void deliver(int fd, Conn &conn);
+};
+
+// this is the return type of the session coroutines. A session starts running as soon as it is
+// called and frees its own frame when it returns, so nobody keeps a handle to it.
+struct Session
+{
+    struct promise_type
+    {
+        Session get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception();
+    };
+};
+
+// this is a class for one client socket as a session coroutine sees it. Every operation is
+// awaited: on an EventLoop the session suspends without holding a thread and is resumed on
+// the loop thread; without one, the operation runs as a blocking call and never suspends.
+class Connection
+{
+public:
+    explicit Connection(int fd, EventLoop *loop = nullptr) : socket(fd), loop(loop) {}
+    int fd() const { return socket; }
+    EventLoop *eventLoop() const { return loop; }
+
+    // co_await yields true with the next message, false on EOF or error
+    struct Receive
+    {
+        Connection &conn;
+        std::string &message;
+        bool ok = false;
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> session);
+        bool await_resume() const { return ok; }
+    };
+
+    // co_await yields true once every byte was sent, false on error. The parts go out as one
+    // vectored write; parts taken from a ChunkWriter are handed back to it afterwards.
+    struct Send
+    {
+        Connection &conn;
+        std::vector<std::string> parts;
+        ChunkWriter *source = nullptr;
+        bool ok = false;
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> session);
+        bool await_resume();
+    };
+
+    // co_await resumes the session on its loop thread once start() called the continuation it was given.
+    // If the work of an offload or a pool handoff threw, co_await rethrows its exception in the session.
+    struct Handoff
+    {
+        Connection &conn;
+        std::function<void(std::function<void()> resume)> start;
+        std::shared_ptr<std::exception_ptr> error = nullptr; // Set by the work of offload or a pool handoff
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> session);
+        void await_resume() const;
+    };
+
+    Receive receive(std::string &message) { return Receive{*this, message}; }
+    Send send(std::string data);
+    Send send(std::vector<std::string> parts) { return Send{*this, std::move(parts)}; }
+    Send send(ChunkWriter &body) { return Send{*this, body.take(), &body}; } // Sends what body has buffered
+    Handoff handoff(std::function<void(std::function<void()> resume)> start) { return Handoff{*this, std::move(start)}; }
+    Handoff handoff(WorkStealingPool &pool, std::function<void(std::function<void()> resume)> start); // start on the pool, inline without a loop
+    Handoff offload(WorkStealingPool &pool, std::function<void()> work); // Runs work on the pool, inline without a loop
+    void close();
+
+private:
+    int socket;
+    EventLoop *loop;
+};
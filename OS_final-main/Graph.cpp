@@ -1,27 +1,120 @@
 #include "Graph.hpp"
+#include <limits>
 
-Graph::Graph(vector<vector<int>> adjMat): adjMat(adjMat) {
-    int VerticesNum = adjMat.size();
+// The weight range of every WeightMatrix alternative, in the same order
+static const Weight CELL_MIN[] = {0, 0, numeric_limits<int>::min(), 0, numeric_limits<Weight>::min()};
+static const Weight CELL_MAX[] = {numeric_limits<uint8_t>::max(), numeric_limits<uint16_t>::max(), numeric_limits<int>::max(),
+                                  numeric_limits<uint32_t>::max(), numeric_limits<Weight>::max()};
+
+// Index of the narrowest WeightMatrix alternative that holds every weight in [minWeight, maxWeight]
+static size_t narrowestCells(Weight minWeight, Weight maxWeight) {
+    size_t cells = 0;
+    while (minWeight < CELL_MIN[cells] || maxWeight > CELL_MAX[cells]) {
+        cells++;
+    }
+    return cells;
+}
+
+// The matrix in Cell cells: moved if it has them already, converted otherwise
+template <typename Cell, typename T>
+static FlatMatrix<Cell> withCells(FlatMatrix<T> &matrix) {
+    if constexpr (is_same_v<Cell, T>) {
+        return std::move(matrix);
+    } else {
+        return FlatMatrix<Cell>(matrix);
+    }
+}
+
+template <typename T>
+static WeightMatrix withCells(FlatMatrix<T> &matrix, size_t cells) {
+    switch (cells) {
+    case 0:
+        return withCells<uint8_t>(matrix);
+    case 1:
+        return withCells<uint16_t>(matrix);
+    case 2:
+        return withCells<int>(matrix);
+    case 3:
+        return withCells<uint32_t>(matrix);
+    default:
+        return withCells<Weight>(matrix);
+    }
+}
+
+Graph::Graph(Matrix adjMat) {
+    load(adjMat);
+}
+
+template <typename T>
+Graph::Graph(FlatMatrix<T> adjMat) {
+    load(adjMat);
+}
+
+template Graph::Graph(FlatMatrix<uint8_t>);
+template Graph::Graph(FlatMatrix<uint16_t>);
+template Graph::Graph(FlatMatrix<uint32_t>);
+template Graph::Graph(FlatMatrix<Weight>);
+
+// Validates the matrix, counts its edges and asymmetric pairs, and stores it in the narrowest cells
+template <typename T>
+void Graph::load(FlatMatrix<T> &adjMat) {
+    if (adjMat.rows() != adjMat.cols()) {
+        throw invalid_argument("The adjacency matrix must be square");
+    }
+    VerticesNum = adjMat.size();
     numEdges = 0;
+    asymmetricPairs = 0;
+    T minWeight = 0, maxWeight = 0;
+    edgeBits = BitMatrix(VerticesNum, VerticesNum);
     for (int i = 0; i < VerticesNum; i++) {
         for(int j=0;j<VerticesNum;j++){
-            if(adjMat.at(i).at(i)!=0){
+            if(adjMat[i][i]!=0){
                 throw invalid_argument("The numbers on the Diagonal  must be zero");
             }
-            if(adjMat.at(i).at(j)!=0){
+            if(adjMat[i][j]!=0){
             numEdges++;
         }
+            if(adjMat[i][j]>0){
+                edgeBits.set(i, j, true);
+            }
+            minWeight = min(minWeight, adjMat[i][j]);
+            maxWeight = max(maxWeight, adjMat[i][j]);
     }
 }
+
+    // Compared in square tiles, so the column side of every comparison stays in cache
+    const int TILE = 64;
+    for (int bi = 0; bi < VerticesNum; bi += TILE) {
+        for (int bj = bi; bj < VerticesNum; bj += TILE) {
+            for (int i = bi; i < min(bi + TILE, VerticesNum); i++) {
+                for (int j = max(bj, i + 1); j < min(bj + TILE, VerticesNum); j++) {
+                    if (adjMat[i][j] != adjMat[j][i]) {
+                        asymmetricPairs++;
+                    }
+                }
+            }
+        }
+    }
+
+    this->adjMat = withCells(adjMat, narrowestCells(minWeight, maxWeight));
 }
 
 int Graph::getNumVertices(){
     return VerticesNum;
 }
-vector<vector<int>> Graph::getAdjMat(){
-    return adjMat;
+FlatMatrix<Weight> Graph::getAdjMat() const {
+    return visitAdjMat([](const auto &matrix) { return FlatMatrix<Weight>(matrix); });
+}
+Weight Graph::weight(int source, int destination) const {
+    return visitAdjMat([&](const auto &matrix) { return (Weight)matrix[source][destination]; });
 }
-void Graph::addEdge(int source, int destination, int weight) {
+size_t Graph::cellSize() const {
+    return visitAdjMat([](const auto &matrix) { return sizeof(typename decay_t<decltype(matrix)>::value_type); });
+}
+size_t Graph::matrixBytes() const {
+    return visitAdjMat([](const auto &matrix) { return matrix.rows() * matrix.cols() * sizeof(typename decay_t<decltype(matrix)>::value_type); });
+}
+void Graph::addEdge(int source, int destination, Weight weight) {
     // Validate source and destination indices
     std::cout<<source<<std::endl;
     std::cout<<destination<<std::endl;
@@ -30,7 +123,18 @@ void Graph::addEdge(int source, int destination, int weight) {
     if (source < 0 || source >= VerticesNum || destination < 0 || destination >= VerticesNum) {
         throw std::invalid_argument("Vertex index is invalid. Ensure source and destination are within bounds.");
     }
-    adjMat.at(source).at(destination) = weight;
+    // Storage is never narrowed again, only widened to cells that hold both the old range and
+    // the new weight (int and uint32_t cells together need int64_t ones)
+    size_t cells = adjMat.index();
+    size_t wider = narrowestCells(min(CELL_MIN[cells], weight), max(CELL_MAX[cells], weight));
+    if (wider != cells) {
+        WeightMatrix widened = std::visit([&](auto &matrix) { return withCells(matrix, wider); }, adjMat);
+        adjMat = std::move(widened);
+    }
+    bool wasAsymmetric = this->weight(source, destination) != this->weight(destination, source);
+    std::visit([&](auto &matrix) { matrix.at(source, destination) = weight; }, adjMat);
+    edgeBits.set(source, destination, weight > 0);
+    asymmetricPairs += (weight != this->weight(destination, source)) - wasAsymmetric;
     // Optionally log the addition
     std::cout << "Edge added: (" << source << " -> " << destination << ") with weight " << weight << std::endl;
 }
@@ -40,5 +144,11 @@ void Graph::removeEdge(int source, int destiantion){
         throw invalid_argument(" vertex index is Invalid ");
     }
     std::cout << "The edge from " << source << " to " << destiantion << " has been removed" << std::endl;
-    adjMat.at(source).at(destiantion) = 0;
+    bool wasAsymmetric = std::visit([&](auto &matrix) {
+        bool was = matrix.at(source, destiantion) != matrix.at(destiantion, source);
+        matrix.at(source, destiantion) = 0;
+        return was;
+    }, adjMat);
+    edgeBits.set(source, destiantion, false);
+    asymmetricPairs += (0 != weight(destiantion, source)) - wasAsymmetric;
 }   
@@ -1,17 +1,51 @@
 #pragma once
 #include <iostream>
 #include <vector>
+#include <cstdint>
+#include <variant>
+#include "Matrix.hpp"
+#include "BitMatrix.hpp"
 using namespace std;
+
+// Weights and every sum of them are 64-bit wherever they leave the stored matrix
+using Weight = int64_t;
+
+// The weights are stored in the narrowest cells that hold them all: one byte for weights up to
+// 255, two up to 65535, then int, uint32_t and int64_t. Dense scans read a quarter or half of the
+// memory that way, and graphs of small weights never pay for the 64-bit ones.
+// The alternatives are ordered from narrow to wide; addEdge relies on that.
+using WeightMatrix = std::variant<FlatMatrix<uint8_t>, FlatMatrix<uint16_t>, Matrix, FlatMatrix<uint32_t>, FlatMatrix<Weight>>;
+
 // this is a calss for a weighted directed Graph
 class Graph {
-    vector<vector<int>> adjMat;
+    WeightMatrix adjMat;
+    BitMatrix edgeBits; // Set where adjMat[i][j] > 0, the cells the MST algorithms take as edges
     int VerticesNum;
     int numEdges;
+    int asymmetricPairs; // Pairs i < j with adjMat[i][j] != adjMat[j][i]
+    template <typename T>
+    void load(FlatMatrix<T> &adjMat);
 public:
-Graph(vector<vector<int>> adjMat);
-vector<vector<int>> getAdjMat();
+Graph(Matrix adjMat); // Nested vectors convert to a Matrix
+// The other cell types of WeightMatrix, e.g. FlatMatrix<Weight> for weights beyond int.
+// A template, so Graph({}) still means the Matrix constructor.
+template <typename T>
+explicit Graph(FlatMatrix<T> adjMat);
+FlatMatrix<Weight> getAdjMat() const; // A copy widened to Weight cells
+Weight weight(int source, int destination) const;
+size_t cellSize() const; // Bytes per stored weight: 1, 2, 4 or 8
+size_t matrixBytes() const; // Bytes of the stored weights
+size_t indexBytes() const { return edgeBits.bytes(); } // Bytes of the edge bitset
+const BitMatrix &getEdgeBits() const { return edgeBits; }
+// Calls visitor with the stored FlatMatrix, whichever cell type it has
+template <typename Visitor>
+decltype(auto) visitAdjMat(Visitor &&visitor) const
+{
+    return std::visit(std::forward<Visitor>(visitor), adjMat);
+}
 int getNumVertices();
-void addEdge(int source, int destiantion, int weight);
+bool isSymmetric() const { return asymmetricPairs == 0; } // Every edge is stored in both rows
+void addEdge(int source, int destiantion, Weight weight);
 void removeEdge(int source, int destiantion);
 void setnumberofVertices(int num)
 {
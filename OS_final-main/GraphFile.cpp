@@ -0,0 +1,287 @@
+#include "GraphFile.hpp"
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+uint64_t alignSection(uint64_t position)
+{
+    return (position + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+
+uint64_t graphFileChecksum(const void *data, size_t size)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    uint64_t hash = 14695981039346656037ull;
+    const uint64_t prime = 1099511628211ull;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        hash = (hash ^ word) * prime;
+    }
+    for (; i < size; i++)
+        hash = (hash ^ bytes[i]) * prime;
+    return hash;
+}
+
+static uint64_t headerChecksum(const GraphFileHeader &header)
+{
+    return graphFileChecksum(&header, offsetof(GraphFileHeader, headerChecksum));
+}
+
+// Index of FlatMatrix<Cell> in WeightMatrix, the cellType of the header
+template <typename Cell, size_t Index = 0>
+static constexpr uint32_t cellTypeOf()
+{
+    if constexpr (is_same_v<variant_alternative_t<Index, WeightMatrix>, FlatMatrix<Cell>>)
+        return Index;
+    else
+        return cellTypeOf<Cell, Index + 1>();
+}
+
+void writeAll(int fd, const void *data, size_t size, const string &path)
+{
+    const char *bytes = static_cast<const char *>(data);
+    while (size > 0)
+    {
+        ssize_t n = ::write(fd, bytes, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            throw runtime_error("Cannot write " + path + ": " + strerror(errno));
+        bytes += n;
+        size -= n;
+    }
+}
+
+void syncDirectoryOf(const string &path)
+{
+    size_t slash = path.rfind('/');
+    string directory = slash == string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        throw runtime_error("Cannot open " + directory + ": " + strerror(errno));
+    int result = ::fsync(fd);
+    int error = errno;
+    ::close(fd);
+    if (result < 0)
+        throw runtime_error("Cannot sync " + directory + ": " + strerror(error));
+}
+
+uint64_t saveGraphFile(const Graph &graph, const string &path)
+{
+    return graph.visitAdjMat([&](const auto &adj)
+                             {
+        using Cell = typename decay_t<decltype(adj)>::value_type;
+        size_t n = adj.rows();
+        vector<uint64_t> offsets(n + 1, 0);
+        vector<uint32_t> targets;
+        vector<Cell> weights;
+        for (size_t i = 0; i < n; i++)
+        {
+            for (size_t j = 0; j < n; j++)
+            {
+                if (adj[i][j] != 0)
+                {
+                    targets.push_back(j);
+                    weights.push_back(adj[i][j]);
+                }
+            }
+            offsets[i + 1] = targets.size();
+        }
+
+        GraphFileHeader header{};
+        memcpy(header.magic, GraphFileHeader::MAGIC, sizeof(header.magic));
+        header.version = GraphFileHeader::VERSION;
+        header.byteOrder = GraphFileHeader::ENDIAN_MARK;
+        header.cellType = cellTypeOf<Cell>();
+        header.cellSize = sizeof(Cell);
+        header.vertices = n;
+        header.edges = targets.size();
+        header.offsetsAt = alignSection(sizeof(GraphFileHeader));
+        header.targetsAt = alignSection(header.offsetsAt + offsets.size() * sizeof(uint64_t));
+        header.weightsAt = alignSection(header.targetsAt + targets.size() * sizeof(uint32_t));
+        header.fileSize = header.weightsAt + weights.size() * sizeof(Cell);
+        header.offsetsChecksum = graphFileChecksum(offsets.data(), offsets.size() * sizeof(uint64_t));
+        header.targetsChecksum = graphFileChecksum(targets.data(), targets.size() * sizeof(uint32_t));
+        header.weightsChecksum = graphFileChecksum(weights.data(), weights.size() * sizeof(Cell));
+        header.headerChecksum = headerChecksum(header);
+
+        string temporary = path + ".tmp";
+        int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+            throw runtime_error("Cannot create " + temporary + ": " + strerror(errno));
+        try
+        {
+            static const char padding[SECTION_ALIGNMENT] = {};
+            uint64_t written = 0;
+            auto section = [&](uint64_t at, const void *data, size_t size)
+            {
+                writeAll(fd, padding, at - written, temporary);
+                writeAll(fd, data, size, temporary);
+                written = at + size;
+            };
+            section(0, &header, sizeof(header));
+            section(header.offsetsAt, offsets.data(), offsets.size() * sizeof(uint64_t));
+            section(header.targetsAt, targets.data(), targets.size() * sizeof(uint32_t));
+            section(header.weightsAt, weights.data(), weights.size() * sizeof(Cell));
+            if (::fsync(fd) < 0)
+                throw runtime_error("Cannot sync " + temporary + ": " + strerror(errno));
+        }
+        catch (...)
+        {
+            ::close(fd);
+            ::unlink(temporary.c_str());
+            throw;
+        }
+        ::close(fd);
+        if (::rename(temporary.c_str(), path.c_str()) < 0)
+        {
+            ::unlink(temporary.c_str());
+            throw runtime_error("Cannot rename " + temporary + " to " + path + ": " + strerror(errno));
+        }
+        syncDirectoryOf(path);
+        return header.headerChecksum;
+    });
+}
+
+MappedFile::MappedFile(const string &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw runtime_error("Cannot open " + path + ": " + strerror(errno));
+    struct stat info;
+    if (::fstat(fd, &info) < 0)
+    {
+        int error = errno;
+        ::close(fd);
+        throw runtime_error("Cannot stat " + path + ": " + strerror(error));
+    }
+    length = info.st_size;
+    if (length > 0)
+        address = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    int error = errno;
+    ::close(fd); // The mapping keeps the file open
+    if (address == MAP_FAILED)
+        throw runtime_error("Cannot map " + path + ": " + strerror(error));
+    if (length > 0)
+        ::madvise(address, length, MADV_SEQUENTIAL);
+}
+
+MappedFile::~MappedFile()
+{
+    if (length > 0)
+        ::munmap(address, length);
+}
+
+template <size_t... Index>
+static size_t cellSizeOf(uint32_t cellType, index_sequence<Index...>)
+{
+    static const size_t sizes[] = {sizeof(typename variant_alternative_t<Index, WeightMatrix>::value_type)...};
+    return sizes[cellType];
+}
+
+// Throws unless the header describes sections that lie inside a file of fileSize bytes
+static void checkHeader(const GraphFileHeader &header, size_t fileSize, const string &path)
+{
+    if (memcmp(header.magic, GraphFileHeader::MAGIC, sizeof(header.magic)) != 0)
+        throw runtime_error(path + " is not a graph file");
+    if (header.byteOrder != GraphFileHeader::ENDIAN_MARK)
+        throw runtime_error(path + " was written on a machine of the other byte order");
+    if (header.version != GraphFileHeader::VERSION)
+        throw runtime_error(path + " has unsupported graph file version " + to_string(header.version));
+    if (header.headerChecksum != headerChecksum(header))
+        throw runtime_error(path + " has a corrupt header");
+    if (header.fileSize != fileSize)
+        throw runtime_error(path + " is truncated");
+
+    if (header.cellType >= variant_size_v<WeightMatrix> ||
+        header.cellSize != cellSizeOf(header.cellType, make_index_sequence<variant_size_v<WeightMatrix>>()))
+        throw runtime_error(path + " has an unknown cell type");
+    if (header.vertices > static_cast<uint64_t>(numeric_limits<int>::max()) ||
+        header.edges > header.vertices * header.vertices)
+        throw runtime_error(path + " has a corrupt header");
+
+    auto fits = [&](uint64_t at, uint64_t count, uint64_t size)
+    { return at % SECTION_ALIGNMENT == 0 && at <= fileSize && count <= (fileSize - at) / size; };
+    if (!fits(header.offsetsAt, header.vertices + 1, sizeof(uint64_t)) ||
+        !fits(header.targetsAt, header.edges, sizeof(uint32_t)) ||
+        !fits(header.weightsAt, header.edges, header.cellSize))
+        throw runtime_error(path + " is truncated");
+}
+
+// Expands the checked CSR sections into the dense cells of a graph
+template <typename Cell>
+static Graph buildGraph(const GraphFileHeader &header, const unsigned char *file, const string &path)
+{
+    const uint64_t *offsets = reinterpret_cast<const uint64_t *>(file + header.offsetsAt);
+    const uint32_t *targets = reinterpret_cast<const uint32_t *>(file + header.targetsAt);
+    const Cell *weights = reinterpret_cast<const Cell *>(file + header.weightsAt);
+    size_t n = header.vertices;
+    if (offsets[0] != 0 || offsets[n] != header.edges)
+        throw runtime_error(path + " has corrupt row offsets");
+
+    FlatMatrix<Cell> matrix(n, n);
+    for (size_t i = 0; i < n; i++)
+    {
+        if (offsets[i + 1] < offsets[i] || offsets[i + 1] > header.edges)
+            throw runtime_error(path + " has corrupt row offsets");
+        Cell *row = matrix[i];
+        for (uint64_t k = offsets[i]; k < offsets[i + 1]; k++)
+        {
+            if (targets[k] >= n)
+                throw runtime_error(path + " has an edge to a vertex out of range");
+            row[targets[k]] = weights[k];
+        }
+    }
+    return Graph(std::move(matrix));
+}
+
+template <size_t... Index>
+static Graph buildGraphOfType(const GraphFileHeader &header, const unsigned char *file, const string &path, index_sequence<Index...>)
+{
+    using Builder = Graph (*)(const GraphFileHeader &, const unsigned char *, const string &);
+    static const Builder builders[] = {buildGraph<typename variant_alternative_t<Index, WeightMatrix>::value_type>...};
+    return builders[header.cellType](header, file, path);
+}
+
+Graph loadGraphFile(const string &path, uint64_t *id)
+{
+    MappedFile file(path);
+    size_t size = file.size();
+    if (size < sizeof(GraphFileHeader))
+        throw runtime_error(path + " is not a graph file");
+
+    const GraphFileHeader &header = *reinterpret_cast<const GraphFileHeader *>(file.bytes());
+    checkHeader(header, size, path);
+    const unsigned char *bytes = file.bytes();
+    if (graphFileChecksum(bytes + header.offsetsAt, (header.vertices + 1) * sizeof(uint64_t)) != header.offsetsChecksum ||
+        graphFileChecksum(bytes + header.targetsAt, header.edges * sizeof(uint32_t)) != header.targetsChecksum ||
+        graphFileChecksum(bytes + header.weightsAt, header.edges * header.cellSize) != header.weightsChecksum)
+        throw runtime_error(path + " fails its checksum");
+    if (id)
+        *id = header.headerChecksum;
+    return buildGraphOfType(header, bytes, path, make_index_sequence<variant_size_v<WeightMatrix>>());
+}
+
+Graph preloadGraphFile(const string &path, uint64_t *id)
+{
+    if (::access(path.c_str(), F_OK) < 0 && errno == ENOENT)
+    {
+        if (id)
+            *id = 0;
+        return Graph{Matrix()};
+    }
+    return loadGraphFile(path, id);
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "Graph.hpp"
+
+// The binary graph file, version 1. The sections follow the header in this order, each starting
+// on a 64-byte boundary:
+//   offsets  (vertices + 1) x uint64_t  start of every row's entries in targets and weights
+//   targets  edges x uint32_t           column of every nonzero cell, row by row
+//   weights  edges x cell               the weights, in the cells the graph stores them in
+// Integers are in the byte order of the machine that wrote the file, which the loader checks.
+struct GraphFileHeader
+{
+    static constexpr char MAGIC[8] = {'M', 'S', 'T', 'G', 'R', 'A', 'P', 'H'};
+    static const uint32_t VERSION = 1;
+    static const uint32_t ENDIAN_MARK = 0x01020304; // Reads back differently on the other byte order
+
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t cellType; // Index of the cell type in WeightMatrix
+    uint32_t cellSize;
+    uint64_t vertices;
+    uint64_t edges;
+    uint64_t offsetsAt; // Byte positions of the sections in the file
+    uint64_t targetsAt;
+    uint64_t weightsAt;
+    uint64_t fileSize;
+    uint64_t offsetsChecksum;
+    uint64_t targetsChecksum;
+    uint64_t weightsChecksum;
+    uint64_t headerChecksum; // Of every field above
+};
+
+// A version of a persisted graph: its snapshot (see saveGraphFile) and the number of logged
+// mutations on top of it (see GraphStore). Files derived from the graph are keyed by it.
+struct GraphVersion
+{
+    uint64_t snapshot = 0;
+    uint64_t mutations = 0;
+    bool operator==(const GraphVersion &) const = default;
+};
+
+/**
+ * saveGraphFile
+ * Writes the graph to a temporary file next to path, syncs it, and renames it over path,
+ * so a crash leaves either the old file or the complete new one.
+ *
+ * @return The header checksum of the file, which identifies its contents.
+ * @throws runtime_error if the file cannot be written.
+ */
+uint64_t saveGraphFile(const Graph &graph, const std::string &path);
+
+/**
+ * loadGraphFile
+ * Maps the file read-only, checks the header and the checksums of the sections, and
+ * expands the sparse rows of the mapping into the graph's own dense matrix. The mapping
+ * replaces a read buffer and text parsing; it is unmapped once the graph is built.
+ *
+ * @param id Set to the header checksum of the file, if given.
+ * @throws runtime_error if the file cannot be read, is not a graph file of a supported
+ *         version, is truncated, or fails a checksum.
+ */
+Graph loadGraphFile(const std::string &path, uint64_t *id = nullptr);
+
+// Function: preloadGraphFile
+// Loads the graph a server starts with (--graph): the file if it exists, an empty graph (id 0) if not yet.
+Graph preloadGraphFile(const std::string &path, uint64_t *id = nullptr);
+
+uint64_t graphFileChecksum(const void *data, size_t size); // 64-bit FNV-1a over 8-byte words
+
+// this is a class that keeps a file mapped read-only for as long as it lives
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string &path); // Throws runtime_error if it cannot be opened or mapped
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const unsigned char *bytes() const { return static_cast<const unsigned char *>(address); }
+    size_t size() const { return length; }
+
+private:
+    void *address = nullptr;
+    size_t length = 0;
+};
+
+static const uint64_t SECTION_ALIGNMENT = 64;
+uint64_t alignSection(uint64_t position); // Rounds up to the next section boundary
+
+// Writes all of data to fd, resuming after partial writes; throws runtime_error naming path
+void writeAll(int fd, const void *data, size_t size, const std::string &path);
+
+// Syncs the directory holding path, so a file just renamed to path stays renamed after a crash
+void syncDirectoryOf(const std::string &path);
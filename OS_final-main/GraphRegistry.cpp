@@ -0,0 +1,283 @@
+#include "GraphRegistry.hpp"
+#include <cctype>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+using namespace std;
+
+// Separates the name of a graph from the --graph file in the name of its snapshot
+static const char NAME_SEPARATOR = '@';
+
+function<bool()> evictCachedMst(weak_ptr<GraphState> graph, MstAlgorithm algorithm, unsigned long version)
+{
+    return [graph, algorithm, version]()
+    {
+        auto state = graph.lock();
+        if (!state)
+            return false;
+        lock_guard<std::mutex> lock(state->mutex);
+        auto cached = state->mstCache.find(algorithm);
+        if (cached == state->mstCache.end() || cached->second.version != version)
+            return false;
+        state->mstCache.erase(cached); // Requests still holding the MST keep it until they are done
+        return true;
+    };
+}
+
+GraphRegistry::GraphRegistry(string path, MemoryBudget *budget) : path(std::move(path)), budget(budget)
+{
+    auto state = make_shared<GraphState>(); // In memory until load opens its files
+    charge(DEFAULT_GRAPH, *state);
+    graphs[DEFAULT_GRAPH] = make_shared<Slot>(std::move(state));
+}
+
+bool GraphRegistry::validName(const string &name)
+{
+    if (name.empty() || name.size() > 64)
+        return false;
+    for (unsigned char c : name)
+    {
+        if (!isalnum(c) && c != '_' && c != '-')
+            return false;
+    }
+    return true;
+}
+
+string GraphRegistry::pathOf(const string &name) const
+{
+    return name == DEFAULT_GRAPH ? path : path + NAME_SEPARATOR + name;
+}
+
+shared_ptr<GraphState> GraphRegistry::open(const string &name, size_t *replayed)
+{
+    auto state = make_shared<GraphState>();
+    if (!path.empty())
+    {
+        state->store = make_unique<GraphStore>(pathOf(name));
+        state->graph = state->store->load(replayed);
+    }
+    charge(name, *state);
+    return state;
+}
+
+void GraphRegistry::charge(const string &name, GraphState &state)
+{
+    if (!budget)
+        return;
+    // Only a graph that can be loaded again is evicted, and never the one sessions start on
+    function<bool()> evict;
+    if (state.store && name != DEFAULT_GRAPH)
+        evict = [this, name, expected = &state]()
+        { return unload(name, expected); };
+    state.charge = budget->charge(MemoryKind::Graph, {state.graph.matrixBytes(), state.graph.indexBytes()}, std::move(evict));
+}
+
+shared_ptr<GraphRegistry::Slot> GraphRegistry::slotOf(const string &name) const
+{
+    lock_guard<std::mutex> lock(mutex);
+    auto found = graphs.find(name);
+    return found == graphs.end() ? nullptr : found->second;
+}
+
+bool GraphRegistry::unload(const string &name, const GraphState *expected)
+{
+    auto slot = slotOf(name);
+    if (!slot)
+        return false;
+    shared_ptr<GraphState> state;
+    {
+        lock_guard<std::mutex> lock(slot->mutex);
+        // Sessions and requests hold their own handles: only a graph nobody works on is unloaded
+        if (slot->busy || slot->state.get() != expected || slot->state.use_count() > 1)
+            return false;
+        state = std::move(slot->state);
+        slot->busy = true; // A find waits for the save rather than load files still being written
+    }
+    bool saved = true;
+    try
+    {
+        state->store->checkpoint(state->graph);
+    }
+    catch (const runtime_error &e)
+    {
+        cerr << e.what() << endl;
+        saved = false;
+    }
+    if (saved)
+        state.reset(); // The load on the next find reads the snapshot and an empty log
+    {
+        lock_guard<std::mutex> lock(slot->mutex);
+        slot->state = std::move(state); // Back in place if it could not be saved
+        slot->busy = false;
+    }
+    slot->moved.notify_all();
+    return saved;
+}
+
+vector<pair<string, size_t>> GraphRegistry::load()
+{
+    // A graph always has a log, from the moment it is created: the logs name the graphs
+    filesystem::path file(path);
+    filesystem::path directory = file.has_parent_path() ? file.parent_path() : filesystem::path(".");
+    string prefix = file.filename().string() + NAME_SEPARATOR;
+    vector<string> found = {DEFAULT_GRAPH};
+    try
+    {
+        for (const auto &entry : filesystem::directory_iterator(directory))
+        {
+            string filename = entry.path().filename().string();
+            if (filename.size() > prefix.size() + 4 && filename.compare(0, prefix.size(), prefix) == 0 &&
+                filename.compare(filename.size() - 4, 4, ".log") == 0)
+            {
+                string name = filename.substr(prefix.size(), filename.size() - prefix.size() - 4);
+                if (validName(name) && name != DEFAULT_GRAPH)
+                    found.push_back(name);
+            }
+        }
+    }
+    catch (const filesystem::filesystem_error &e)
+    {
+        throw runtime_error(e.what());
+    }
+
+    vector<pair<string, size_t>> loaded;
+    lock_guard<std::mutex> lock(mutex);
+    for (const string &name : found)
+    {
+        size_t replayed = 0;
+        graphs[name] = make_shared<Slot>(open(name, &replayed));
+        loaded.emplace_back(name, replayed);
+    }
+    return loaded;
+}
+
+shared_ptr<GraphState> GraphRegistry::find(const string &name)
+{
+    auto slot = slotOf(name);
+    if (!slot)
+        return nullptr;
+    unique_lock<std::mutex> lock(slot->mutex);
+    slot->moved.wait(lock, [&]()
+                     { return !slot->busy; });
+    if (slot->dropped)
+        return nullptr;
+    if (budget)
+    {
+        if (slot->state)
+            budget->hit(MemoryKind::Graph);
+        else
+            budget->miss(MemoryKind::Graph);
+    }
+    if (!slot->state)
+    {
+        // Loaded without any lock held: finds of this graph wait for it, all others go on
+        slot->busy = true;
+        lock.unlock();
+        shared_ptr<GraphState> state;
+        try
+        {
+            state = open(name, nullptr);
+        }
+        catch (...)
+        {
+            lock.lock();
+            slot->busy = false;
+            slot->moved.notify_all();
+            throw;
+        }
+        lock.lock();
+        slot->state = std::move(state);
+        slot->busy = false;
+        slot->moved.notify_all();
+    }
+    slot->state->charge.touch();
+    return slot->state;
+}
+
+shared_ptr<GraphState> GraphRegistry::create(const string &name)
+{
+    if (!validName(name))
+        throw invalid_argument("Graph names are 1 to 64 letters, digits, '_' or '-'");
+    lock_guard<std::mutex> lock(mutex);
+    if (graphs.count(name))
+        throw invalid_argument("Graph " + name + " already exists");
+    if (!path.empty())
+        GraphStore::removeFiles(pathOf(name));
+    auto state = open(name, nullptr);
+    graphs[name] = make_shared<Slot>(state);
+    return state;
+}
+
+void GraphRegistry::drop(const string &name)
+{
+    if (name == DEFAULT_GRAPH)
+        throw invalid_argument("The default graph cannot be dropped");
+    shared_ptr<Slot> slot;
+    {
+        lock_guard<std::mutex> lock(mutex);
+        auto found = graphs.find(name);
+        if (found == graphs.end())
+            throw invalid_argument("No graph named " + name);
+        slot = std::move(found->second);
+        graphs.erase(found);
+    }
+    shared_ptr<GraphState> state;
+    {
+        // A save or load under way finishes first, so no file is written after it is deleted
+        unique_lock<std::mutex> lock(slot->mutex);
+        slot->moved.wait(lock, [&]()
+                         { return !slot->busy; });
+        state = std::move(slot->state);
+        slot->dropped = true;
+    }
+    slot->moved.notify_all();
+    if (!state)
+        GraphStore::removeFiles(pathOf(name)); // Evicted: only its files are left
+    else if (state->store)
+        state->store->drop();
+}
+
+vector<string> GraphRegistry::names() const
+{
+    lock_guard<std::mutex> lock(mutex);
+    vector<string> result;
+    for (const auto &entry : graphs)
+        result.push_back(entry.first);
+    return result;
+}
+
+void GraphRegistry::checkpointAll()
+{
+    vector<shared_ptr<Slot>> slots;
+    {
+        lock_guard<std::mutex> lock(mutex);
+        for (const auto &entry : graphs)
+            slots.push_back(entry.second);
+    }
+    for (const auto &slot : slots)
+    {
+        shared_ptr<GraphState> state;
+        {
+            lock_guard<std::mutex> lock(slot->mutex); // A graph being unloaded is saved by its eviction
+            state = slot->state;
+        }
+        if (!state || !state->store)
+            continue;
+        GraphStore::CheckpointTicket ticket;
+        Graph copy({});
+        {
+            lock_guard<std::mutex> lock(state->mutex); // Only for the copy: the write goes on without it
+            ticket = state->store->beginCheckpoint();
+            copy = state->graph;
+        }
+        try
+        {
+            state->store->checkpoint(copy, ticket);
+        }
+        catch (const runtime_error &e)
+        {
+            cerr << e.what() << endl;
+        }
+    }
+}
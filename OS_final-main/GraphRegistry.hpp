@@ -0,0 +1,138 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Graph.hpp"
+#include "GraphStore.hpp"
+#include "MemoryBudget.hpp"
+#include "MST.hpp"
+
+// An MST in the cache of its graph, built from the given version of the graph
+struct CachedMst
+{
+    unsigned long version;
+    std::shared_ptr<MST> mst;
+    MemoryBudget::Charge charge;
+};
+
+/**
+ * Struct: GraphState
+ * One graph of the registry with its own lock and MST cache. The version is bumped on every
+ * mutation so the MSTs cached per algorithm can be checked for staleness without comparing
+ * matrices.
+ */
+struct GraphState
+{
+    std::mutex mutex;
+    Graph graph{Matrix()};
+    unsigned long version = 0;
+    std::map<MstAlgorithm, CachedMst> mstCache;
+    std::unique_ptr<GraphStore> store; // Snapshot and mutation log (--graph), null without one
+    MemoryBudget::Charge charge;       // Bytes of the graph, if the registry has a budget
+
+    void recharge() { charge.resize({graph.matrixBytes(), graph.indexBytes()}); } // After the graph changed
+};
+
+/**
+ * evictCachedMst
+ * The evict function to charge a cached MST with: drops it from its graph's cache, unless
+ * the graph is gone or its cache already moved on to another version.
+ */
+std::function<bool()> evictCachedMst(std::weak_ptr<GraphState> graph, MstAlgorithm algorithm, unsigned long version);
+
+/**
+ * Class: GraphRegistry
+ * The named graphs of a server. Every session starts on the default graph and can create,
+ * select and drop others, so independent workloads share one server without sharing a graph.
+ * Sessions hold their graph by a shared handle: a dropped graph leaves the registry at once,
+ * but lives on for the sessions still bound to it until they select another one.
+ *
+ * With --graph FILE the default graph is kept at FILE and a graph named NAME at FILE@NAME,
+ * each with its own log and MST files (see GraphStore), and load finds them again on startup.
+ * With a memory budget as well, a graph no session is bound to can be evicted: it is saved
+ * and unloaded, and loaded again by the next find. The default graph always stays. Saving and
+ * loading happen outside the registry's lock; a find of a graph on its way out or back in
+ * waits for that graph alone.
+ */
+class GraphRegistry
+{
+public:
+    static constexpr const char *DEFAULT_GRAPH = "default";
+
+    // path is the --graph file, empty to keep every graph in memory only; the budget, if
+    // given, is charged for the graphs and must outlive the registry
+    explicit GraphRegistry(std::string path = "", MemoryBudget *budget = nullptr);
+
+    /**
+     * load
+     * Opens the default graph and every named graph saved next to it. Only with a path.
+     *
+     * @return The name of each graph with the number of logged changes replayed into it.
+     * @throws runtime_error if a graph cannot be loaded.
+     */
+    std::vector<std::pair<std::string, size_t>> load();
+
+    /**
+     * find
+     * Returns the graph of that name, loading it again if it was evicted. Waits while the
+     * graph is being saved for an eviction or loaded by another find.
+     *
+     * @return The graph, or null if there is none.
+     * @throws runtime_error if an evicted graph cannot be loaded.
+     */
+    std::shared_ptr<GraphState> find(const std::string &name);
+
+    /**
+     * create
+     * Adds an empty graph. Files left at its path by an older graph of that name are deleted.
+     *
+     * @throws invalid_argument if the name is taken or not a valid name (see validName).
+     * @throws runtime_error if its files cannot be created.
+     */
+    std::shared_ptr<GraphState> create(const std::string &name);
+
+    /**
+     * drop
+     * Removes a graph and deletes its files. Sessions bound to it keep it until they select another.
+     *
+     * @throws invalid_argument for the default graph or a name that is not in the registry.
+     * @throws runtime_error if its files cannot be deleted; it is out of the registry all the same.
+     */
+    void drop(const std::string &name);
+
+    std::vector<std::string> names() const; // Sorted
+
+    // Saves every graph as its new snapshot, as on shutdown; failures are reported on stderr
+    void checkpointAll();
+
+    static bool validName(const std::string &name); // 1 to 64 letters, digits, '_' or '-'
+
+private:
+    // The place of one name in the registry, with a lock of its own for unloading and loading
+    struct Slot
+    {
+        std::mutex mutex;
+        std::condition_variable moved; // Signalled when busy is cleared
+        std::shared_ptr<GraphState> state; // Null for a graph evicted to its files
+        bool busy = false;    // Being saved for an eviction or loaded again; state is null meanwhile
+        bool dropped = false; // Out of the registry: a find that waited on it finds nothing
+
+        explicit Slot(std::shared_ptr<GraphState> state) : state(std::move(state)) {}
+    };
+
+    std::string path;
+    MemoryBudget *budget;
+    mutable std::mutex mutex; // Guards the map only; each slot is locked after it, never before
+    std::map<std::string, std::shared_ptr<Slot>> graphs;
+
+    std::string pathOf(const std::string &name) const;
+    std::shared_ptr<GraphState> open(const std::string &name, size_t *replayed);
+    void charge(const std::string &name, GraphState &state); // Charges the graph to the budget, if any
+    bool unload(const std::string &name, const GraphState *expected); // The evict function of a graph
+    std::shared_ptr<Slot> slotOf(const std::string &name) const;      // Null if there is none
+};
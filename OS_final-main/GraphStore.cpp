@@ -0,0 +1,437 @@
+#include "GraphStore.hpp"
+#include "GraphFile.hpp"
+#include "MstFile.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+// The log is folded into a new snapshot once it is as large as the snapshot, but not before it
+// holds this many bytes, so small graphs are not rewritten every few mutations
+static const uint64_t MIN_CHECKPOINT_BYTES = 1 << 20;
+
+static uint64_t logHeaderChecksum(const MutationLogHeader &header)
+{
+    return graphFileChecksum(&header, offsetof(MutationLogHeader, checksum));
+}
+
+static uint64_t recordChecksum(const MutationRecord &record)
+{
+    return graphFileChecksum(&record, offsetof(MutationRecord, checksum));
+}
+
+// Size of the file at path, 0 if there is none
+static uint64_t fileSize(const string &path)
+{
+    struct stat info;
+    return ::stat(path.c_str(), &info) == 0 ? info.st_size : 0;
+}
+
+// Reads the whole file, or returns false if it does not exist
+static bool readFile(const string &path, vector<char> &bytes)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0 && errno == ENOENT)
+        return false;
+    if (fd < 0)
+        throw runtime_error("Cannot open " + path + ": " + strerror(errno));
+    bytes.clear();
+    char buffer[1 << 16];
+    ssize_t n;
+    while ((n = ::read(fd, buffer, sizeof(buffer))) != 0)
+    {
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+        {
+            int error = errno;
+            ::close(fd);
+            throw runtime_error("Cannot read " + path + ": " + strerror(error));
+        }
+        bytes.insert(bytes.end(), buffer, buffer + n);
+    }
+    ::close(fd);
+    return true;
+}
+
+GraphStore::GraphStore(const string &path) : snapshotPath(path), logPath(path + ".log")
+{
+    flusher = thread([this]()
+                     { flushLoop(); });
+}
+
+GraphStore::~GraphStore()
+{
+    {
+        lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        wake.notify_one();
+    }
+    flusher.join();
+    if (logFd >= 0)
+        ::close(logFd);
+}
+
+void GraphStore::apply(Graph &graph, const Mutation &mutation)
+{
+    switch (mutation.kind)
+    {
+    case Mutation::AddEdge:
+        graph.addEdge(mutation.from, mutation.to, mutation.weight);
+        break;
+    case Mutation::RemoveEdge:
+        graph.removeEdge(mutation.from, mutation.to);
+        break;
+    default:
+        throw invalid_argument("Unknown mutation kind " + to_string(mutation.kind));
+    }
+}
+
+Graph GraphStore::load(size_t *replayed)
+{
+    Graph graph = preloadGraphFile(snapshotPath, &base);
+    snapshotBytes = fileSize(snapshotPath);
+    if (replayed)
+        *replayed = 0;
+
+    vector<char> bytes;
+    if (!readFile(logPath, bytes))
+    {
+        resetLog(base);
+        return graph;
+    }
+    MutationLogHeader header;
+    if (bytes.size() < sizeof(header))
+        throw runtime_error(logPath + " is not a mutation log");
+    memcpy(&header, bytes.data(), sizeof(header));
+    if (memcmp(header.magic, MutationLogHeader::MAGIC, sizeof(header.magic)) != 0 ||
+        header.checksum != logHeaderChecksum(header))
+        throw runtime_error(logPath + " is not a mutation log");
+    if (header.byteOrder != GraphFileHeader::ENDIAN_MARK)
+        throw runtime_error(logPath + " was written on a machine of the other byte order");
+    if (header.version != MutationLogHeader::VERSION)
+        throw runtime_error(logPath + " has unsupported mutation log version " + to_string(header.version));
+    if (header.base != base)
+    {
+        // Written before the snapshot was saved: the snapshot already holds all of it
+        resetLog(base);
+        return graph;
+    }
+
+    // Replay up to the first record that did not reach the disk whole
+    size_t count = 0;
+    for (size_t at = sizeof(header); at + sizeof(MutationRecord) <= bytes.size(); at += sizeof(MutationRecord))
+    {
+        MutationRecord record;
+        memcpy(&record, bytes.data() + at, sizeof(record));
+        if (record.checksum != recordChecksum(record))
+            break;
+        try
+        {
+            apply(graph, Mutation{Mutation::Kind(record.kind), record.from, record.to, record.weight});
+        }
+        catch (const invalid_argument &)
+        {
+            break;
+        }
+        count++;
+    }
+    logBytes = count * sizeof(MutationRecord);
+    appended = count;
+
+    logFd = ::open(logPath.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    if (logFd < 0)
+        throw runtime_error("Cannot open " + logPath + ": " + strerror(errno));
+    if (sizeof(header) + logBytes < bytes.size() &&
+        (::ftruncate(logFd, sizeof(header) + logBytes) < 0 || ::fdatasync(logFd) < 0))
+        throw runtime_error("Cannot cut the torn tail off " + logPath + ": " + strerror(errno));
+    if (replayed)
+        *replayed = count;
+    return graph;
+}
+
+void GraphStore::append(const Mutation &mutation, function<void(bool durable)> onDurable)
+{
+    MutationRecord record{};
+    record.kind = mutation.kind;
+    record.from = mutation.from;
+    record.to = mutation.to;
+    record.weight = mutation.weight;
+    record.checksum = recordChecksum(record);
+
+    lock_guard<std::mutex> lock(mutex);
+    appended++;
+    nextSeq++;
+    pending.push_back(record);
+    waiting.push_back(std::move(onDurable));
+    wake.notify_one();
+}
+
+bool GraphStore::needsCheckpoint() const
+{
+    lock_guard<std::mutex> lock(mutex);
+    return begun.empty() &&
+           (failed || logBytes + pending.size() * sizeof(MutationRecord) >= max(snapshotBytes, MIN_CHECKPOINT_BYTES));
+}
+
+GraphStore::CheckpointTicket GraphStore::beginCheckpoint(bool replaced)
+{
+    lock_guard<std::mutex> lock(mutex);
+    if (replaced)
+        appended++; // Not a record, but the version must name the new graph
+    CheckpointTicket ticket = nextTicket++;
+    begun[ticket] = Begun{nextSeq, appended, replaced};
+    return ticket;
+}
+
+/**
+ * checkpoint
+ * Writes the snapshot with no lock of the store held, so appends go on meanwhile; they are
+ * held back, since the old log does not match a replaced graph. Once the snapshot is in
+ * place the log is reset, the held records the copy already holds are durable in it, and
+ * the others are logged after it. A crash before the new log is in place leaves the old
+ * log, which names the old snapshot and is discarded on load.
+ */
+void GraphStore::checkpoint(const Graph &copy, CheckpointTicket ticket)
+{
+    lock_guard<std::mutex> serial(checkpointing);
+    unique_lock<std::mutex> lock(mutex);
+    auto found = begun.find(ticket);
+    if (found == begun.end()) // A checkpoint that began later already saved a newer copy
+        return;
+    Begun mine = found->second;
+    // Every record the flusher may still take is older than the copy: let it reach the old
+    // log, so the log is not closed under the flusher
+    waitUntilFlushed(lock);
+    if (dropped)
+    {
+        begun.erase(found);
+        wake.notify_one();
+        return;
+    }
+    GraphVersion before{base, mine.mutations};
+    lock.unlock();
+
+    // Until the new log is in place, a failure leaves records the old log cannot take
+    auto abandon = [this, ticket]()
+    {
+        begun.erase(ticket);
+        failed = true;
+        wake.notify_one();
+        idle.notify_all();
+    };
+    uint64_t saved;
+    try
+    {
+        saved = saveGraphFile(copy, snapshotPath);
+    }
+    catch (...)
+    {
+        lock.lock();
+        abandon();
+        throw;
+    }
+
+    lock.lock();
+    waitUntilFlushed(lock);
+    try
+    {
+        resetLog(saved);
+    }
+    catch (...)
+    {
+        abandon();
+        throw;
+    }
+    snapshotBytes = fileSize(snapshotPath);
+    failed = false;
+
+    // The held records older than the copy are in the snapshot; the rest start the new log
+    uint64_t first = nextSeq - pending.size();
+    size_t covered = mine.seq > first ? min<uint64_t>(pending.size(), mine.seq - first) : 0;
+    vector<function<void(bool)>> inSnapshot(make_move_iterator(waiting.begin()), make_move_iterator(waiting.begin() + covered));
+    pending.erase(pending.begin(), pending.begin() + covered);
+    waiting.erase(waiting.begin(), waiting.begin() + covered);
+    begun.erase(begun.begin(), begun.upper_bound(ticket)); // Older copies than this one are not saved
+    appended = pending.size();
+    for (const auto &later : begun)
+        appended += later.second.replaced;
+    wake.notify_one();
+    lock.unlock();
+
+    for (auto &onDurable : inSnapshot)
+        onDurable(true);
+    // The saved MSTs of the graph as it was copied are those of the new snapshot
+    if (!mine.replaced)
+    {
+        for (MstAlgorithm algorithm : {MstAlgorithm::Kruskal, MstAlgorithm::Boruvka})
+            MstFile::rekey(before, GraphVersion{saved, 0}, mstPath(snapshotPath, algorithm));
+    }
+}
+
+GraphVersion GraphStore::version() const
+{
+    lock_guard<std::mutex> lock(mutex);
+    return GraphVersion{base, appended};
+}
+
+string GraphStore::mstPath(const string &path, MstAlgorithm algorithm)
+{
+    return path + (algorithm == MstAlgorithm::Kruskal ? ".kruskal.mst" : ".boruvka.mst");
+}
+
+unique_ptr<MST> GraphStore::loadMst(MstAlgorithm algorithm, GraphVersion version) const
+{
+    return MstFile::load(algorithm, version, mstPath(snapshotPath, algorithm));
+}
+
+void GraphStore::saveMst(const MST &mst, MstAlgorithm algorithm, GraphVersion version)
+{
+    {
+        lock_guard<std::mutex> lock(mutex);
+        if (failed || dropped || version.snapshot != base || version.mutations > logBytes / sizeof(MutationRecord))
+            return;
+    }
+    try
+    {
+        MstFile::save(mst, algorithm, version, mstPath(snapshotPath, algorithm));
+    }
+    catch (const runtime_error &e)
+    {
+        cerr << e.what() << endl;
+    }
+}
+
+void GraphStore::drop()
+{
+    lock_guard<std::mutex> serial(checkpointing);
+    unique_lock<std::mutex> lock(mutex);
+    waitUntilFlushed(lock);
+    dropped = true;
+    removeFiles(snapshotPath);
+}
+
+void GraphStore::removeFiles(const string &path)
+{
+    // The log goes first: a graph whose log is gone is no longer found on startup
+    for (const string &file : {path + ".log", path, mstPath(path, MstAlgorithm::Kruskal), mstPath(path, MstAlgorithm::Boruvka)})
+        ::unlink(file.c_str());
+    syncDirectoryOf(path);
+}
+
+size_t GraphStore::flushable() const
+{
+    if (begun.empty())
+        return pending.size();
+    uint64_t first = nextSeq - pending.size();
+    uint64_t held = begun.begin()->second.seq; // The oldest copy lacks this record and all later ones
+    return held > first ? min<uint64_t>(pending.size(), held - first) : 0;
+}
+
+void GraphStore::waitUntilFlushed(unique_lock<std::mutex> &lock)
+{
+    idle.wait(lock, [this]()
+              { return flushable() == 0 && !flushing; });
+}
+
+void GraphStore::resetLog(uint64_t base)
+{
+    MutationLogHeader header{};
+    memcpy(header.magic, MutationLogHeader::MAGIC, sizeof(header.magic));
+    header.version = MutationLogHeader::VERSION;
+    header.byteOrder = GraphFileHeader::ENDIAN_MARK;
+    header.base = base;
+    header.checksum = logHeaderChecksum(header);
+
+    string temporary = logPath + ".tmp";
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
+        throw runtime_error("Cannot create " + temporary + ": " + strerror(errno));
+    try
+    {
+        writeAll(fd, &header, sizeof(header), temporary);
+        if (::fsync(fd) < 0)
+            throw runtime_error("Cannot sync " + temporary + ": " + strerror(errno));
+        if (::rename(temporary.c_str(), logPath.c_str()) < 0)
+            throw runtime_error("Cannot rename " + temporary + " to " + logPath + ": " + strerror(errno));
+        syncDirectoryOf(logPath);
+    }
+    catch (...)
+    {
+        ::close(fd);
+        ::unlink(temporary.c_str());
+        throw;
+    }
+    if (logFd >= 0)
+        ::close(logFd);
+    logFd = fd; // Still open for appending, now under the name of the log
+    logBytes = 0;
+    this->base = base;
+    appended = 0;
+}
+
+/**
+ * flushLoop
+ * Runs on the flusher thread: takes every record appended since the last batch, writes them
+ * with one write and makes them durable with one fdatasync, then calls their onDurable.
+ * Records appended while a batch is on its way to the disk form the next batch. Records held
+ * back for a checkpoint stay pending; after a failed batch the records are refused, since
+ * replay would apply them on top of the lost ones.
+ */
+void GraphStore::flushLoop()
+{
+    unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        wake.wait(lock, [this]()
+                  { return flushable() > 0 || stopping; });
+        size_t count = flushable();
+        if (count == 0)
+            return;
+        vector<MutationRecord> batch(pending.begin(), pending.begin() + count);
+        pending.erase(pending.begin(), pending.begin() + count);
+        vector<function<void(bool)>> done(make_move_iterator(waiting.begin()), make_move_iterator(waiting.begin() + count));
+        waiting.erase(waiting.begin(), waiting.begin() + count);
+        flushing = true;
+        bool refused = failed;
+        int fd = logFd;
+        uint64_t durableBytes = logBytes;
+        lock.unlock();
+
+        bool durable = !refused;
+        try
+        {
+            if (!refused)
+            {
+                writeAll(fd, batch.data(), batch.size() * sizeof(MutationRecord), logPath);
+                if (::fdatasync(fd) < 0)
+                    throw runtime_error("Cannot sync " + logPath + ": " + strerror(errno));
+            }
+        }
+        catch (const runtime_error &e)
+        {
+            cerr << e.what() << endl;
+            durable = false;
+            // Replay must not stop at a torn record before the hole is checkpointed
+            if (::ftruncate(fd, sizeof(MutationLogHeader) + durableBytes) < 0)
+                cerr << "Cannot cut the torn tail off " << logPath << ": " << strerror(errno) << endl;
+        }
+        for (auto &onDurable : done)
+            onDurable(durable);
+
+        lock.lock();
+        flushing = false;
+        if (durable)
+            logBytes += batch.size() * sizeof(MutationRecord);
+        else
+            failed = true;
+        idle.notify_all();
+    }
+}
@@ -0,0 +1,190 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Graph.hpp"
+#include "GraphFile.hpp"
+#include "MST.hpp"
+
+// One logged change of the graph: options 2 and 3
+struct Mutation
+{
+    enum Kind : uint32_t
+    {
+        AddEdge = 1,
+        RemoveEdge = 2
+    };
+    Kind kind;
+    int from;
+    int to;
+    Weight weight = 0; // Of AddEdge
+};
+
+// The mutation log, "<graph file>.log", version 1: a header naming the snapshot the records
+// apply to, then one fixed-size record per mutation, each with its own checksum.
+struct MutationLogHeader
+{
+    static constexpr char MAGIC[8] = {'M', 'S', 'T', 'M', 'U', 'L', 'O', 'G'};
+    static const uint32_t VERSION = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder; // GraphFileHeader::ENDIAN_MARK
+    uint64_t base;      // Id of the snapshot (see saveGraphFile), 0 for none
+    uint64_t checksum;  // Of every field above
+};
+
+struct MutationRecord
+{
+    uint32_t kind;
+    int32_t from;
+    int32_t to;
+    uint32_t unused;
+    int64_t weight;
+    uint64_t checksum; // Of every field above
+};
+
+/**
+ * Class: GraphStore
+ * Keeps a graph durable across restarts as a snapshot file (see GraphFile.hpp) plus a log of
+ * the mutations made since. Mutations are appended to the log without waiting: a flusher
+ * thread writes whatever has accumulated with one write and one fdatasync, then tells every
+ * mutation of the batch that it is durable (group commit). Once the log outgrows the snapshot
+ * a checkpoint folds it into a new snapshot and empties it, so a restart loads the snapshot
+ * and replays only a short tail. A checkpoint writes a copy of the graph taken under the
+ * caller's lock, and the caller releases that lock while the copy is written. Mutations
+ * appended meanwhile are held back and logged after the new snapshot. Built MSTs are kept next to them as MST files (see
+ * MstFile.hpp), "<graph file>.<algorithm>.mst", keyed by the graph version they were built from.
+ */
+class GraphStore
+{
+public:
+    // The log is written next to the snapshot, at path + ".log"
+    explicit GraphStore(const std::string &path);
+    ~GraphStore(); // Flushes what is pending, then stops the flusher
+    GraphStore(const GraphStore &) = delete;
+    GraphStore &operator=(const GraphStore &) = delete;
+
+    /**
+     * load
+     * Loads the snapshot (an empty graph if there is none yet) and replays the log records
+     * written after it. A torn or corrupt tail, left by a crash in the middle of a write, is
+     * cut off; a log left from an older snapshot is discarded. Called once, before append.
+     *
+     * @param replayed Set to the number of records replayed, if given.
+     * @throws runtime_error if the snapshot or the log cannot be read or written.
+     */
+    Graph load(size_t *replayed = nullptr);
+
+    /**
+     * append
+     * Logs a mutation that was just applied to the graph. Mutations are logged in the order
+     * of the calls, which must be the order they were applied in. Once a batch could not be
+     * written, the log has a hole: later records are refused, not logged on top of it, until
+     * a checkpoint saves the whole graph again.
+     *
+     * @param onDurable Called on the flusher thread once the record is on disk, or in the
+     *                  snapshot of a checkpoint; with false if it could not be logged.
+     */
+    void append(const Mutation &mutation, std::function<void(bool durable)> onDurable);
+
+    // The log has grown past the size of the snapshot, or lost a batch; false while a
+    // checkpoint is under way
+    bool needsCheckpoint() const;
+
+    using CheckpointTicket = uint64_t;
+
+    /**
+     * beginCheckpoint
+     * Starts a checkpoint of the graph as it is now. Call it with the graph locked and copy
+     * the graph before unlocking; from here on appended records are held back until the
+     * checkpoint is done, so none lands in a log the copy does not match.
+     *
+     * @param replaced The graph was replaced as a whole, which the log cannot record: its
+     *                 version changes at once, and MSTs of the old graph are not carried over.
+     */
+    CheckpointTicket beginCheckpoint(bool replaced = false);
+
+    /**
+     * checkpoint
+     * Saves the copy taken at beginCheckpoint as the new snapshot, without the graph's lock,
+     * and starts a new log with the records held back since. If a later checkpoint already
+     * saved a newer copy, this does nothing. If the snapshot cannot be written, later records
+     * are refused until a checkpoint succeeds.
+     *
+     * @throws runtime_error if the snapshot or the log cannot be written.
+     */
+    void checkpoint(const Graph &copy, CheckpointTicket ticket);
+
+    // Checkpoints a graph nobody else can change until it returns
+    void checkpoint(const Graph &graph) { checkpoint(graph, beginCheckpoint()); }
+
+    static void apply(Graph &graph, const Mutation &mutation); // Applies a mutation, as replay does
+
+    GraphVersion version() const; // Of the graph with every appended mutation applied
+
+    // The saved MST of the algorithm for that graph version, or null if there is none
+    std::unique_ptr<MST> loadMst(MstAlgorithm algorithm, GraphVersion version) const;
+
+    /**
+     * saveMst
+     * Saves an MST built from the graph at the given version, unless that version is no longer
+     * the current snapshot or is not yet durable: a version lost in a crash could come back
+     * with other mutations. Failures are reported on stderr; the file is only a cache.
+     */
+    void saveMst(const MST &mst, MstAlgorithm algorithm, GraphVersion version);
+
+    /**
+     * drop
+     * Deletes the files of the graph once what is pending is flushed. Later checkpoints and
+     * MST saves do nothing, so a session still working on the graph cannot bring them back.
+     *
+     * @throws runtime_error if the directory cannot be synced.
+     */
+    void drop();
+
+    static void removeFiles(const std::string &path); // The snapshot at path, its log and its MST files
+
+private:
+    std::string snapshotPath;
+    std::string logPath;
+    int logFd = -1;
+
+    // A checkpoint between beginCheckpoint and the end of checkpoint
+    struct Begun
+    {
+        uint64_t seq;       // First record the copy lacks: it and the later ones are held back
+        uint64_t mutations; // appended when it began, for rekeying the MST files
+        bool replaced;
+    };
+
+    std::mutex checkpointing; // One snapshot write at a time, and no drop during one
+    mutable std::mutex mutex;
+    std::condition_variable wake; // The flusher has work, or should stop
+    std::condition_variable idle; // A batch reached the disk
+    std::vector<MutationRecord> pending;
+    std::vector<std::function<void(bool)>> waiting; // onDurable of the pending records
+    uint64_t nextSeq = 0;        // Sequence number of the next append; pending ends just before it
+    CheckpointTicket nextTicket = 1;
+    std::map<CheckpointTicket, Begun> begun; // In the order they began, which is the order of the copies
+    bool flushing = false;
+    bool stopping = false;
+    uint64_t logBytes = 0;       // Records on disk
+    uint64_t snapshotBytes = 0;  // Size of the last snapshot
+    uint64_t base = 0;           // Id of the snapshot
+    uint64_t appended = 0;       // Mutations since the snapshot: logged, pending or refused
+    bool failed = false;         // A batch could not be written: the log no longer matches the graph
+    bool dropped = false;        // The files are deleted: nothing is saved any more
+    std::thread flusher;
+
+    void flushLoop();
+    void resetLog(uint64_t base); // Replaces the log by an empty one for the snapshot base
+    size_t flushable() const;     // Pending records that are not held back for a checkpoint
+    void waitUntilFlushed(std::unique_lock<std::mutex> &lock);
+    static std::string mstPath(const std::string &path, MstAlgorithm algorithm);
+};
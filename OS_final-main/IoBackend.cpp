@@ -0,0 +1,766 @@
+#include "IoBackend.hpp"
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <iostream>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+#include <unordered_map>
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#if defined(IORING_RECV_MULTISHOT) && defined(IORING_ACCEPT_MULTISHOT) && defined(__NR_io_uring_setup)
+#define HAVE_IO_URING 1
+#endif
+
+using namespace std;
+
+static void setNonBlocking(int fd)
+{
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+// this is the readiness-based fallback: it emulates completions with epoll and nonblocking syscalls
+class EpollBackend : public IoBackend
+{
+    struct PendingSend
+    {
+        vector<string> parts;
+        size_t part = 0;   // First part not fully sent
+        size_t offset = 0; // Bytes of that part already sent
+        size_t total = 0;
+        uint64_t token;
+    };
+    struct FdState
+    {
+        bool listening = false;
+        bool receiving = false;
+        bool registered = false;
+        deque<PendingSend> sends;
+    };
+
+    int epollFd;
+    int wakeFd;
+    unordered_map<int, FdState> fds;
+    vector<IoEvent> ready; // Completions that happened without waiting
+
+    // Registers the events the fd currently needs
+    void update(int fd, FdState &state)
+    {
+        epoll_event event{};
+        event.data.fd = fd;
+        if (state.listening || state.receiving)
+            event.events |= EPOLLIN | EPOLLRDHUP;
+        if (!state.sends.empty())
+            event.events |= EPOLLOUT;
+
+        if (event.events == 0)
+        {
+            if (state.registered)
+                epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+            state.registered = false;
+        }
+        else
+        {
+            epoll_ctl(epollFd, state.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &event);
+            state.registered = true;
+        }
+    }
+
+    // Sends as much of the queued data as the socket takes, with one sendmsg() over the parts
+    // of every queued chain, and completes the chains that went out entirely
+    void flush(int fd, FdState &state)
+    {
+        static const int MAX_IOV = 64;
+        while (!state.sends.empty())
+        {
+            iovec iov[MAX_IOV];
+            int count = 0;
+            size_t requested = 0;
+            for (auto &pending : state.sends)
+            {
+                for (size_t i = pending.part; i < pending.parts.size() && count < MAX_IOV; i++)
+                {
+                    size_t offset = i == pending.part ? pending.offset : 0;
+                    iov[count].iov_base = pending.parts[i].data() + offset;
+                    iov[count].iov_len = pending.parts[i].size() - offset;
+                    requested += iov[count++].iov_len;
+                }
+                if (count == MAX_IOV)
+                    break;
+            }
+
+            msghdr message{};
+            message.msg_iov = iov;
+            message.msg_iovlen = count;
+            ssize_t n = sendmsg(fd, &message, MSG_NOSIGNAL);
+            if (n < 0)
+            {
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    return; // EPOLLOUT resumes here
+                if (errno == EINTR)
+                    continue;
+                int error = errno;
+                for (auto &failed : state.sends)
+                    ready.push_back({IoEvent::Send, fd, -error, failed.token, {}, std::move(failed.parts)});
+                state.sends.clear();
+                return;
+            }
+
+            // Advance over what was sent, completing every chain that is now fully out
+            size_t left = n;
+            while (!state.sends.empty())
+            {
+                PendingSend &pending = state.sends.front();
+                while (pending.part < pending.parts.size())
+                {
+                    size_t step = min(left, pending.parts[pending.part].size() - pending.offset);
+                    pending.offset += step;
+                    pending.total += step;
+                    left -= step;
+                    if (pending.offset < pending.parts[pending.part].size())
+                        break;
+                    pending.part++;
+                    pending.offset = 0;
+                }
+                if (pending.part < pending.parts.size())
+                    break;
+                ready.push_back({IoEvent::Send, fd, (int)pending.total, pending.token, {}, std::move(pending.parts)});
+                state.sends.pop_front();
+            }
+            if (size_t(n) < requested)
+                return; // The socket buffer is full
+        }
+    }
+
+public:
+    EpollBackend()
+    {
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epollFd < 0 || wakeFd < 0)
+            throw runtime_error(string("epoll setup failed: ") + strerror(errno));
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = wakeFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+    }
+
+    ~EpollBackend() override
+    {
+        close(wakeFd);
+        close(epollFd);
+    }
+
+    const char *name() const override { return "epoll"; }
+
+    void watchAccept(int listenFd) override
+    {
+        setNonBlocking(listenFd);
+        FdState &state = fds[listenFd];
+        state.listening = true;
+        update(listenFd, state);
+    }
+
+    void watchRecv(int fd) override
+    {
+        setNonBlocking(fd);
+        FdState &state = fds[fd];
+        state.receiving = true;
+        update(fd, state);
+    }
+
+    void unwatch(int fd) override
+    {
+        auto it = fds.find(fd);
+        if (it == fds.end())
+            return;
+        for (auto &pending : it->second.sends)
+            ready.push_back({IoEvent::Send, fd, -ECANCELED, pending.token, {}, std::move(pending.parts)});
+        if (it->second.registered)
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        fds.erase(it);
+    }
+
+    void send(int fd, vector<string> parts, uint64_t token) override
+    {
+        FdState &state = fds[fd];
+        PendingSend pending;
+        pending.parts = std::move(parts);
+        pending.token = token;
+        state.sends.push_back(std::move(pending));
+        if (state.sends.size() == 1)
+            flush(fd, state);
+        update(fd, state);
+    }
+
+    void wait(vector<IoEvent> &events) override
+    {
+        epoll_event polled[64];
+        int n = epoll_wait(epollFd, polled, 64, ready.empty() ? -1 : 0);
+        for (int i = 0; i < n; i++)
+        {
+            int fd = polled[i].data.fd;
+            if (fd == wakeFd)
+            {
+                uint64_t value;
+                while (read(wakeFd, &value, sizeof(value)) > 0)
+                {
+                }
+                continue;
+            }
+            auto it = fds.find(fd);
+            if (it == fds.end())
+                continue;
+            FdState &state = it->second;
+
+            if (state.listening)
+            {
+                int client;
+                while ((client = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC)) >= 0)
+                    ready.push_back({IoEvent::Accept, fd, client, 0, {}});
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                    ready.push_back({IoEvent::Accept, fd, -errno, 0, {}});
+                continue;
+            }
+
+            if (state.receiving && (polled[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)))
+            {
+                string data;
+                char buffer[16384];
+                int result = 0;
+                while (true)
+                {
+                    ssize_t r = read(fd, buffer, sizeof(buffer));
+                    if (r > 0)
+                    {
+                        data.append(buffer, r);
+                        continue;
+                    }
+                    if (r < 0 && errno == EINTR)
+                        continue;
+                    if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                        break;
+                    result = r == 0 ? 0 : -errno; // EOF or error ends the stream
+                    state.receiving = false;
+                    break;
+                }
+                if (!data.empty())
+                    ready.push_back({IoEvent::Recv, fd, (int)data.size(), 0, std::move(data)});
+                if (!state.receiving)
+                    ready.push_back({IoEvent::Recv, fd, result, 0, {}});
+            }
+            if (polled[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+                flush(fd, state);
+            update(fd, state);
+        }
+        for (auto &event : ready)
+            events.push_back(std::move(event));
+        ready.clear();
+    }
+
+    void wake() override
+    {
+        uint64_t one = 1;
+        if (write(wakeFd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+            cerr << "EventLoop wake failed: " << strerror(errno) << endl;
+    }
+};
+
+#ifdef HAVE_IO_URING
+
+// this is the io_uring backend: submissions are batched into one io_uring_enter per wait(),
+// accept and recv are multishot, received data lands in a registered provided-buffer ring,
+// and the parts of a response go out as one chain of linked sends.
+class UringBackend : public IoBackend
+{
+    enum Op : uint64_t
+    {
+        OpAccept = 1,
+        OpRecv = 2,
+        OpSend = 3,
+        OpWake = 4,
+        OpCancel = 5,
+    };
+    static const unsigned RING_ENTRIES = 256;
+    static const unsigned BUFFER_COUNT = 256; // Power of two, required by the buffer ring
+    static const unsigned BUFFER_SIZE = 16384;
+    static const uint16_t BUFFER_GROUP = 0;
+
+    struct Chain
+    {
+        int fd;
+        vector<string> parts;
+        vector<size_t> sent;
+        unsigned inflight = 0;
+        int error = 0;
+        uint64_t token;
+    };
+
+    int ringFd = -1;
+    void *sqRing = MAP_FAILED, *cqRing = MAP_FAILED;
+    size_t sqRingSize = 0, cqRingSize = 0;
+    io_uring_sqe *sqes = (io_uring_sqe *)MAP_FAILED;
+    size_t sqesSize = 0;
+    unsigned *sqHead, *sqTail, *sqMask, *sqArray, sqEntries;
+    unsigned *cqHead, *cqTail, *cqMask;
+    io_uring_cqe *cqes;
+    unsigned localTail = 0; // SQEs prepared but not yet published
+    unsigned toSubmit = 0;
+
+    io_uring_buf_ring *bufRing = (io_uring_buf_ring *)MAP_FAILED;
+    char *buffers = (char *)MAP_FAILED;
+    uint16_t bufTail = 0;
+
+    int wakeFd = -1;
+    uint32_t nextGeneration = 1;
+    unordered_map<int, uint32_t> watched; // fd -> generation of its current accept/recv
+    unordered_map<uint64_t, Chain> chains;
+    uint64_t nextChain = 1;
+    vector<IoEvent> ready;
+
+    static uint64_t watchData(Op op, uint32_t generation, int fd)
+    {
+        return (uint64_t(op) << 56) | (uint64_t(generation & 0xffffff) << 32) | uint32_t(fd);
+    }
+    static uint64_t sendData(uint64_t chain, unsigned part)
+    {
+        return (uint64_t(OpSend) << 56) | ((chain & 0xffffffffffULL) << 16) | part;
+    }
+
+    int enter(unsigned submit, unsigned waitNr)
+    {
+        unsigned flags = waitNr ? IORING_ENTER_GETEVENTS : 0;
+        return syscall(__NR_io_uring_enter, ringFd, submit, waitNr, flags, nullptr, 0);
+    }
+
+    // Publishes the prepared SQEs and lets the kernel consume them, optionally waiting for a completion
+    void submit(unsigned waitNr)
+    {
+        __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+        while (true)
+        {
+            int r = enter(toSubmit, waitNr);
+            if (r >= 0)
+            {
+                toSubmit -= min<unsigned>(r, toSubmit);
+                if (toSubmit == 0)
+                    return;
+                waitNr = 0; // Some SQEs were not taken yet, push them before blocking again
+                continue;
+            }
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EBUSY)
+            {
+                reap(); // Completion queue is full, make room first
+                continue;
+            }
+            throw runtime_error(string("io_uring_enter failed: ") + strerror(errno));
+        }
+    }
+
+    io_uring_sqe *getSqe()
+    {
+        if (localTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries)
+            submit(0);
+        unsigned index = localTail & *sqMask;
+        io_uring_sqe *sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqArray[index] = index;
+        localTail++;
+        toSubmit++;
+        return sqe;
+    }
+
+    // Hands a provided buffer back to the kernel
+    void recycle(unsigned bid)
+    {
+        // Index from the ring base: in C++ the empty member of the kernel's flex-array wrapper shifts bufs[] by 8 bytes
+        io_uring_buf *buf = (io_uring_buf *)bufRing + (bufTail & (BUFFER_COUNT - 1));
+        buf->addr = (uint64_t)(buffers + size_t(bid) * BUFFER_SIZE);
+        buf->len = BUFFER_SIZE;
+        buf->bid = bid;
+        bufTail++;
+        __atomic_store_n(&bufRing->tail, bufTail, __ATOMIC_RELEASE);
+    }
+
+    void armAccept(int fd, uint32_t generation)
+    {
+        io_uring_sqe *sqe = getSqe();
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = fd;
+        sqe->accept_flags = SOCK_CLOEXEC;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->user_data = watchData(OpAccept, generation, fd);
+    }
+
+    void armRecv(int fd, uint32_t generation)
+    {
+        io_uring_sqe *sqe = getSqe();
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = fd;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = BUFFER_GROUP;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->user_data = watchData(OpRecv, generation, fd);
+    }
+
+    void armWake()
+    {
+        io_uring_sqe *sqe = getSqe();
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = wakeFd;
+        sqe->poll32_events = POLLIN;
+        sqe->len = IORING_POLL_ADD_MULTI;
+        sqe->user_data = uint64_t(OpWake) << 56;
+    }
+
+    // Queues the unsent remainder of a chain as linked sends
+    void submitChain(uint64_t id, Chain &chain)
+    {
+        vector<unsigned> remaining;
+        for (unsigned i = 0; i < chain.parts.size(); i++)
+        {
+            if (chain.sent[i] < chain.parts[i].size())
+                remaining.push_back(i);
+        }
+        for (size_t k = 0; k < remaining.size(); k++)
+        {
+            unsigned i = remaining[k];
+            io_uring_sqe *sqe = getSqe();
+            sqe->opcode = IORING_OP_SEND;
+            sqe->fd = chain.fd;
+            sqe->addr = (uint64_t)(chain.parts[i].data() + chain.sent[i]);
+            sqe->len = chain.parts[i].size() - chain.sent[i];
+            sqe->msg_flags = MSG_NOSIGNAL;
+            if (k + 1 < remaining.size())
+                sqe->flags = IOSQE_IO_LINK; // Keeps the parts in order without waiting for each one
+            sqe->user_data = sendData(id, i);
+            chain.inflight++;
+        }
+    }
+
+    void completeSend(uint64_t id, unsigned part, int res)
+    {
+        auto it = chains.find(id);
+        if (it == chains.end())
+            return;
+        Chain &chain = it->second;
+        chain.inflight--;
+        if (res > 0)
+            chain.sent[part] += res;
+        else if (res < 0 && res != -ECANCELED && chain.error == 0)
+            chain.error = res; // -ECANCELED only means an earlier link was short
+        if (chain.inflight > 0)
+            return;
+
+        size_t total = 0;
+        bool done = true;
+        for (size_t i = 0; i < chain.parts.size(); i++)
+        {
+            total += chain.sent[i];
+            done = done && chain.sent[i] == chain.parts[i].size();
+        }
+        if (chain.error != 0 || done)
+        {
+            ready.push_back({IoEvent::Send, chain.fd, chain.error != 0 ? chain.error : (int)total, chain.token, {}, std::move(chain.parts)});
+            chains.erase(it);
+        }
+        else
+        {
+            submitChain(id, chain); // A short send broke the link, continue with what is left
+        }
+    }
+
+    void handle(const io_uring_cqe &cqe)
+    {
+        Op op = Op(cqe.user_data >> 56);
+        bool more = cqe.flags & IORING_CQE_F_MORE;
+        if (op == OpSend)
+        {
+            completeSend((cqe.user_data >> 16) & 0xffffffffffULL, cqe.user_data & 0xffff, cqe.res);
+            return;
+        }
+        if (op == OpWake)
+        {
+            uint64_t value;
+            while (read(wakeFd, &value, sizeof(value)) > 0)
+            {
+            }
+            if (!more)
+                armWake();
+            return;
+        }
+        if (op == OpCancel)
+            return;
+
+        int fd = int(uint32_t(cqe.user_data));
+        uint32_t generation = (cqe.user_data >> 32) & 0xffffff;
+        auto it = watched.find(fd);
+        bool current = it != watched.end() && (it->second & 0xffffff) == generation;
+
+        if (op == OpAccept)
+        {
+            if (!current)
+            {
+                if (cqe.res >= 0)
+                    close(cqe.res); // Raced with unwatch()
+                return;
+            }
+            if (cqe.res != -ECANCELED)
+                ready.push_back({IoEvent::Accept, fd, cqe.res, 0, {}});
+            if (!more)
+                armAccept(fd, it->second);
+            return;
+        }
+
+        // OpRecv
+        if (cqe.flags & IORING_CQE_F_BUFFER)
+        {
+            unsigned bid = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+            if (current && cqe.res > 0)
+                ready.push_back({IoEvent::Recv, fd, cqe.res, 0, string(buffers + size_t(bid) * BUFFER_SIZE, cqe.res)});
+            recycle(bid);
+        }
+        if (!current || more)
+            return;
+        if (cqe.res > 0 || cqe.res == -ENOBUFS)
+        {
+            // Multishot ended early. Every buffer is copied out and recycled as soon as its CQE is
+            // handled, so after -ENOBUFS the ring has free buffers again by the time this is submitted
+            armRecv(fd, it->second);
+        }
+        else
+        {
+            ready.push_back({IoEvent::Recv, fd, cqe.res, 0, {}}); // EOF or error
+            watched.erase(it);
+        }
+    }
+
+    void reap()
+    {
+        unsigned head = *cqHead;
+        unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        while (head != tail)
+        {
+            io_uring_cqe cqe = cqes[head & *cqMask];
+            head++;
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+            handle(cqe);
+        }
+    }
+
+    void release()
+    {
+        if (sqes != MAP_FAILED)
+            munmap(sqes, sqesSize);
+        if (cqRing != MAP_FAILED && cqRing != sqRing)
+            munmap(cqRing, cqRingSize);
+        if (sqRing != MAP_FAILED)
+            munmap(sqRing, sqRingSize);
+        if (bufRing != MAP_FAILED)
+            munmap(bufRing, BUFFER_COUNT * sizeof(io_uring_buf));
+        if (buffers != MAP_FAILED)
+            munmap(buffers, size_t(BUFFER_COUNT) * BUFFER_SIZE);
+        if (ringFd >= 0)
+            close(ringFd);
+        if (wakeFd >= 0)
+            close(wakeFd);
+    }
+
+public:
+    // Sets up the rings; throws runtime_error if the kernel lacks anything this backend needs
+    UringBackend()
+    {
+        // Multishot recv with provided-buffer rings needs Linux 6.0
+        utsname info;
+        int major = 0, minor = 0;
+        if (uname(&info) != 0 || sscanf(info.release, "%d.%d", &major, &minor) != 2 || major < 6)
+            throw runtime_error("io_uring multishot recv needs Linux 6.0");
+
+        io_uring_params params{};
+        params.flags = IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+        ringFd = syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+        if (ringFd < 0 && errno == EINVAL)
+        {
+            params = io_uring_params{};
+            ringFd = syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+        }
+        if (ringFd < 0)
+            throw runtime_error(string("io_uring_setup failed: ") + strerror(errno));
+
+        try
+        {
+            sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            if (params.features & IORING_FEAT_SINGLE_MMAP)
+                sqRingSize = cqRingSize = max(sqRingSize, cqRingSize);
+            sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+            if (sqRing == MAP_FAILED)
+                throw runtime_error("mmap of the submission ring failed");
+            cqRing = sqRing;
+            if (!(params.features & IORING_FEAT_SINGLE_MMAP))
+            {
+                cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+                if (cqRing == MAP_FAILED)
+                    throw runtime_error("mmap of the completion ring failed");
+            }
+            sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+            sqes = (io_uring_sqe *)mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+            if (sqes == MAP_FAILED)
+                throw runtime_error("mmap of the submission entries failed");
+
+            char *sq = (char *)sqRing, *cq = (char *)cqRing;
+            sqHead = (unsigned *)(sq + params.sq_off.head);
+            sqTail = (unsigned *)(sq + params.sq_off.tail);
+            sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+            sqArray = (unsigned *)(sq + params.sq_off.array);
+            sqEntries = params.sq_entries;
+            cqHead = (unsigned *)(cq + params.cq_off.head);
+            cqTail = (unsigned *)(cq + params.cq_off.tail);
+            cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+            cqes = (io_uring_cqe *)(cq + params.cq_off.cqes);
+            localTail = *sqTail;
+
+            // Registered ring of provided buffers for multishot recv
+            bufRing = (io_uring_buf_ring *)mmap(nullptr, BUFFER_COUNT * sizeof(io_uring_buf), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            buffers = (char *)mmap(nullptr, size_t(BUFFER_COUNT) * BUFFER_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (bufRing == MAP_FAILED || buffers == MAP_FAILED)
+                throw runtime_error("Allocating the receive buffers failed");
+            io_uring_buf_reg reg{};
+            reg.ring_addr = (uint64_t)bufRing;
+            reg.ring_entries = BUFFER_COUNT;
+            reg.bgid = BUFFER_GROUP;
+            if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+                throw runtime_error(string("Registering the buffer ring failed: ") + strerror(errno));
+            for (unsigned bid = 0; bid < BUFFER_COUNT; bid++)
+                recycle(bid);
+
+            wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (wakeFd < 0)
+                throw runtime_error(string("eventfd failed: ") + strerror(errno));
+            armWake();
+        }
+        catch (...)
+        {
+            release();
+            throw;
+        }
+    }
+
+    ~UringBackend() override { release(); }
+
+    const char *name() const override { return "io_uring"; }
+
+    void watchAccept(int listenFd) override
+    {
+        uint32_t generation = nextGeneration++;
+        watched[listenFd] = generation;
+        armAccept(listenFd, generation);
+    }
+
+    void watchRecv(int fd) override
+    {
+        uint32_t generation = nextGeneration++;
+        watched[fd] = generation;
+        armRecv(fd, generation);
+    }
+
+    void unwatch(int fd) override
+    {
+        auto it = watched.find(fd);
+        if (it != watched.end())
+        {
+            // Cancel by user_data rather than by fd, so sends already in flight still complete
+            for (Op op : {OpAccept, OpRecv})
+            {
+                io_uring_sqe *sqe = getSqe();
+                sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                sqe->addr = watchData(op, it->second, fd);
+                sqe->user_data = uint64_t(OpCancel) << 56;
+            }
+            watched.erase(it);
+        }
+    }
+
+    void send(int fd, vector<string> parts, uint64_t token) override
+    {
+        if (parts.size() > 0xffff)
+        {
+            string joined;
+            for (auto &part : parts)
+                joined += part;
+            parts = {std::move(joined)};
+        }
+        uint64_t id = nextChain++;
+        Chain &chain = chains[id];
+        chain.fd = fd;
+        chain.parts = std::move(parts);
+        chain.sent.assign(chain.parts.size(), 0);
+        chain.token = token;
+        submitChain(id, chain);
+        if (chain.inflight == 0) // Nothing to send
+        {
+            ready.push_back({IoEvent::Send, fd, 0, token, {}, std::move(chain.parts)});
+            chains.erase(id);
+        }
+    }
+
+    void wait(vector<IoEvent> &events) override
+    {
+        submit(ready.empty() ? 1 : 0);
+        reap();
+        for (auto &event : ready)
+            events.push_back(std::move(event));
+        ready.clear();
+    }
+
+    void wake() override
+    {
+        uint64_t one = 1;
+        if (write(wakeFd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+            cerr << "EventLoop wake failed: " << strerror(errno) << endl;
+    }
+};
+
+#endif
+
+/**
+ * makeIoBackend
+ * Creates the requested backend. io_uring falls back to epoll when the kernel, the
+ * headers or a seccomp policy do not allow it.
+ *
+ * @param kind Epoll or Uring.
+ * @return The backend.
+ */
+unique_ptr<IoBackend> makeIoBackend(IoBackendKind kind)
+{
+#ifdef HAVE_IO_URING
+    if (kind == IoBackendKind::Uring)
+    {
+        try
+        {
+            return make_unique<UringBackend>();
+        }
+        catch (const exception &e)
+        {
+            cerr << "io_uring not available (" << e.what() << "), falling back to epoll" << endl;
+        }
+    }
+#else
+    if (kind == IoBackendKind::Uring)
+        cerr << "Built without io_uring support, falling back to epoll" << endl;
+#endif
+    return make_unique<EpollBackend>();
+}
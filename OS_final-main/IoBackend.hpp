@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// One finished operation reported by an IoBackend
+struct IoEvent
+{
+    enum Type
+    {
+        Accept, // result is the new client socket, or -errno
+        Recv,   // data holds the received bytes; result is their count, 0 on EOF, or -errno
+        Send,   // result is the number of bytes sent by the whole chain, or -errno
+    };
+    Type type;
+    int fd;          // Listening socket for Accept, connection for Recv and Send
+    int result;
+    uint64_t token;  // Token passed to send(), 0 otherwise
+    std::string data;
+    std::vector<std::string> parts = {}; // Send: the buffers passed to send(), handed back for reuse
+};
+
+// this is the interface of the completion-based I/O backends behind EventLoop.
+// Except for wake(), all functions must be called from the thread that calls wait().
+class IoBackend
+{
+public:
+    virtual ~IoBackend() = default;
+    virtual const char *name() const = 0;
+    virtual void watchAccept(int listenFd) = 0; // Accept events until unwatch()
+    virtual void watchRecv(int fd) = 0;         // Recv events until EOF, error or unwatch()
+    virtual void unwatch(int fd) = 0;           // Stops Accept/Recv and fails pending sends; call before close()
+    virtual void send(int fd, std::vector<std::string> parts, uint64_t token) = 0; // Sends the parts in order, one Send event at the end
+    virtual void wait(std::vector<IoEvent> &events) = 0; // Submits everything queued and blocks until wake() or at least one event
+    virtual void wake() = 0;                             // Thread-safe
+};
+
+// Which backend the servers use for socket I/O
+enum class IoBackendKind
+{
+    Blocking, // Plain blocking read/send on the session thread, no event loop
+    Epoll,
+    Uring, // io_uring, falls back to epoll where it is not available
+};
+
+// Creates an epoll or io_uring backend; Uring falls back to epoll if io_uring cannot be set up
+std::unique_ptr<IoBackend> makeIoBackend(IoBackendKind kind);
@@ -9,38 +9,162 @@
 #include <unistd.h>
 #include <cstring>
 #include <sstream>
+#include <memory>
 #include "Graph.hpp"
+#include "GraphRegistry.hpp"
 #include "MST.hpp"
+#include "WorkStealingPool.hpp"
+#include "ServerConfig.hpp"
+#include "Acceptor.hpp"
+#include "EventLoop.hpp"
+#include "Serializer.hpp"
+#include "Arena.hpp"
+#include "PathBatch.hpp"
 #include <csignal>
 
-#define PORT 8080          //this the port number on which the server will listen for client connections
-#define THREAD_POOL_SIZE 5  //number of worker threads in the thread pool
+#define PORT 8080          //default port number on which the server will listen for client connections
+#define THREAD_POOL_SIZE 5  //default number of worker threads in the thread pool
 bool close_server=false;
+bool chunkedResponses = false; // Frame streamed results as chunks (--chunked)
+MemoryBudget *memoryBudget = nullptr; // Charged for the graphs (--memory), reported by option 16
+ShardedAcceptor *shardedAcceptor = nullptr; // Set while running in --reuseport mode
+EventLoop *eventLoop = nullptr;             // Set while running with --io epoll or uring
+
+// Function: checkpoint
+// Saves a copy of the graph taken with beginCheckpoint as the new snapshot and empties the
+// mutation log, reporting failures.
+static bool checkpoint(GraphStore &store, const Graph &copy, GraphStore::CheckpointTicket ticket)
+{
+    try
+    {
+        store.checkpoint(copy, ticket);
+        return true;
+    }
+    catch (const std::runtime_error &e)
+    {
+        std::cerr << e.what() << "\n";
+        return false;
+    }
+}
 
-// this is a struct that holds the client socket and the pointer to the graph
+// Function: applyMutation
+// Applies a change to the graph under its lock and invalidates its cached MSTs. With --graph
+// the change is logged in the same critical section, so the log has the changes in the order
+// they were applied, and the session resumes once the group commit made it durable. A
+// checkpoint the log asks for is taken from a copy from before the change and written after
+// the lock is released; the change is logged after its snapshot. co_await rethrows the
+// invalid_argument of a change the graph rejects.
+static Connection::Handoff applyMutation(Connection &conn, WorkStealingPool &pool, std::shared_ptr<GraphState> state, Mutation mutation, bool &durable)
+{
+    return conn.handoff(pool, [state, mutation, &durable](std::function<void()> resume)
+                        {
+        GraphStore *store = state->store.get();
+        GraphStore::CheckpointTicket ticket = 0;
+        Graph copy{Matrix()};
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            bool full = store && store->needsCheckpoint();
+            if (full)
+                copy = state->graph;
+            GraphStore::apply(state->graph, mutation);
+            state->version++;
+            state->mstCache.clear();
+            state->recharge(); // The cells may have widened
+            if (full)
+                ticket = store->beginCheckpoint();
+            if (store)
+                store->append(mutation, [&durable, resume](bool ok)
+                              {
+                    durable = ok;
+                    resume(); });
+        }
+        if (!store)
+            resume();
+        // The change is held back until this checkpoint is written, so it cannot wait for the session
+        else if (ticket)
+            checkpoint(*store, copy, ticket); });
+}
+
+// Function: kruskalTree
+// Returns the Kruskal MST of the current version of the graph from its cache, or builds it.
+// Only the graph copy is taken under the lock, so mutations are not blocked by the build.
+// With --graph a cache miss first loads the tree saved for the graph version, and a tree
+// that had to be built is saved for the next start. Cached trees are charged to the memory
+// budget, which may evict them again.
+static std::shared_ptr<MST> kruskalTree(const std::shared_ptr<GraphState> &graph, WorkStealingPool &pool, std::pmr::memory_resource *scratch)
+{
+    GraphState &state = *graph;
+    Graph snapshot{Matrix()};
+    unsigned long version;
+    GraphVersion savedVersion;
+    std::shared_ptr<MST> mst;
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        auto cached = state.mstCache.find(MstAlgorithm::Kruskal);
+        if (cached != state.mstCache.end() && cached->second.version == state.version)
+        {
+            cached->second.charge.touch();
+            memoryBudget->hit(MemoryKind::Mst);
+            return cached->second.mst;
+        }
+        memoryBudget->miss(MemoryKind::Mst);
+        version = state.version;
+        if (state.store)
+        {
+            savedVersion = state.store->version();
+            mst = state.store->loadMst(MstAlgorithm::Kruskal, savedVersion);
+        }
+        if (!mst)
+            snapshot = state.graph;
+    }
+
+    bool built = !mst;
+    if (built)
+        mst = std::make_shared<MST>(snapshot, MstAlgorithm::Kruskal, &pool, scratch);
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (version == state.version)
+            state.mstCache.insert_or_assign(MstAlgorithm::Kruskal, CachedMst{version, mst,
+                                                                             memoryBudget->charge(MemoryKind::Mst, {mst->treeBytes(), mst->indexBytes()},
+                                                                                                  evictCachedMst(graph, MstAlgorithm::Kruskal, version))});
+    }
+    if (built && state.store)
+        state.store->saveMst(*mst, MstAlgorithm::Kruskal, savedVersion);
+    return mst;
+}
+
+// this is a struct that holds the client socket and the registry of the graphs it can work on
 struct Task
 {
     int CSocket; // The socket descriptor for client connection
-    Graph *Pointer_Graph;  // Pointer to the graph the client will modify
+    GraphRegistry *Registry; // The named graphs; the client starts on the default one
+    EventLoop *Loop = nullptr; // Event loop the socket is attached to, null for blocking I/O
 };
 
-// this is a class that implements the Leader-Follower thread pool pattern
+// this is a class that implements the Leader-Follower thread pool pattern on top of a work-stealing scheduler
 class LeaderFollowerThreadPool
 {
 private:
-    std::vector<std::thread> workers; // Vector of worker threads
-    std::queue<Task> tasks;          // Queue of tasks to be executed 
-    std::mutex queueMutex;            // Mutex to protect access to the task queue
-    std::condition_variable cv;       // Condition variable to signal the worker threads
-    bool stopFlag;                    // Flag to indicate that the thread pool should stop
+    WorkStealingPool sessions; // The leader-follower set: each worker runs one blocking client session at a time
+    WorkStealingPool pool;     // Runs the work sessions offload and the fine-grained MST tasks it spawns
 
+public:
     /**
-     * Function: workerLoop
-     * Each worker thread waits for a task to be assigned. Once assigned, it processes the task.
+     * Function: Menue_process
+     * Runs one client session until the client disconnects. The session is a coroutine:
+     * on an event loop it suspends at every send and receive instead of holding a thread,
+     * and graph building and MST work are offloaded to the pool, where MST construction
+     * spawns its fine-grained tasks. With blocking I/O it runs straight through on a session
+     * worker, which uses the pool only for the MST tasks.
      */
-    void Menue_process(int CSocket, Graph *Pointer_Graph)
+    static Session Menue_process(Connection conn, GraphRegistry &registry, WorkStealingPool &pool)
     {
-        char buffer[1024] = {0}; // Buffer for reading client input
+        std::string buffer; // Client input
+        RequestArena arena; // Scratch memory of the MST constructions, reset after each response
+        std::string graphName = GraphRegistry::DEFAULT_GRAPH;
+        std::shared_ptr<GraphState> current; // Graph the client works on
+        co_await conn.offload(pool, [&]()
+                              { current = registry.find(graphName); }); // The registry's file I/O stays off the loop thread
 
         // Menu to display to the client
         std::string menu =
@@ -54,19 +178,27 @@ private:
             "6. Find the shortest path in the MST (input: start, end nodes)\n"
             "7. Compute the average edge weight in the MST\n"
             "8. Display the MST (adjacency matrix format)\n"
-            "9. Disconnect from the server\n";
+            "9. Disconnect from the server\n"
+            "10. Display the MST as an edge list (u v w per line)\n"
+            "11. Display the MST as a parent array (rooted at vertex 0)\n"
+            "12. Create a named graph and switch to it (input: name)\n"
+            "13. Switch to a named graph (input: name)\n"
+            "14. Drop a named graph (input: name)\n"
+            "15. List the graphs\n"
+            "16. Show memory use and cache statistics\n"
+            "17. Answer a batch of path queries (input: count, then source end pairs)\n"
+            "18. Compute the distance statistics over all pairs of vertices in the MST\n";
         while (true)
         {
             // Send the menu to the client
-            send(CSocket, menu.c_str(), menu.size(), 0);
+            co_await conn.send(menu);
 
             // Read client input
-            ssize_t bytes_read = read(CSocket, buffer, 1024);
-            if (bytes_read <= 0)
+            if (!co_await conn.receive(buffer))
             {
                 std::cerr << "Client disconnected or read error" << std::endl;
-                close(CSocket); // Close client socket upon disconnection or error
-                return;
+                conn.close(); // Close client socket upon disconnection or error
+                co_return;
             }
 
             std::istringstream iss(buffer); // Parse the client's input
@@ -77,242 +209,460 @@ private:
             if (iss.fail())
             {
                 std::string errorMsg = "Invalid input. Please enter a number.\n";
-                send(CSocket, errorMsg.c_str(), errorMsg.size(), 0);
+                co_await conn.send(errorMsg);
                 continue;
             }
 
-            // Handle different menu choices
-            switch (choice)
+            // Streamed results (options 5, 6, 8, 10, 11 and 17) are sent after the switch
+            std::string header;                    // Text before the streamed values
+            std::shared_ptr<MST> mst;              // Keeps what rows refers to
+            std::unique_ptr<BatchSerializer> rows; // The values, formatted one batch at a time
+
+            // A request that fails, in the session or in work it offloaded, gets an error reply
+            std::string failure;
+            try
             {
-            case 0:
-            { // Close the server
-                close(CSocket); // Close the client socket
-                close_server=true;
-                return;
-            }    
-            case 1:
-            { // Create a new graph
-                std::string Vertices_Request = "Enter the number of vertices: ";
-                send(CSocket, Vertices_Request.c_str(), Vertices_Request.size(), 0);
+                // Handle different menu choices
+                switch (choice)
+                {
+                case 0:
+                { // Save the graphs and close the server
+                    co_await conn.offload(pool, [&]()
+                                          { registry.checkpointAll(); });
+                    conn.close(); // Close the client socket
+                    close_server=true;
+                    if (shardedAcceptor)
+                        shardedAcceptor->stop();
+                    if (eventLoop)
+                        eventLoop->stop();
+                    co_return;
+                }    
+                case 1:
+                { // Create a new graph
+                    std::string Vertices_Request = "Enter the number of vertices: ";
+                    co_await conn.send(Vertices_Request);
+
+                    std::string Buffer;
+                    co_await conn.receive(Buffer); // Read number of vertices from client
+                    int numVertices = std::stoi(Buffer);
+
+                    // Create an empty adjacency matrix
+                    FlatMatrix<Weight> adjMat(numVertices, numVertices); // Graph narrows it to the cells its weights need
+
+                    for (int i = 0; i < numVertices; ++i)
+                    {
+                        std::string weightRequest = "Enter row " + std::to_string(i + 1) + " of the adjacency matrix: ";
+                        co_await conn.send(weightRequest);
 
-                char Buffer[1024] = {0};
-                read(CSocket, Buffer, 1024); // Read number of vertices from client
-                int numVertices = std::stoi(Buffer);
+                        std::string rowBuffer;
+                        co_await conn.receive(rowBuffer);
 
-                // Create an empty adjacency matrix
-                std::vector<std::vector<int>> adjMat(numVertices, std::vector<int>(numVertices, 0));
+                        std::istringstream rowStream(rowBuffer);
+                        for (int j = 0; j < numVertices; ++j)
+                        {
+                            rowStream >> adjMat[i][j]; // Fill adjacency matrix from client's input
+                        }
+                    }
 
-                for (int i = 0; i < numVertices; ++i)
-                {
-                    std::string weightRequest = "Enter row " + std::to_string(i + 1) + " of the adjacency matrix: ";
-                    send(CSocket, weightRequest.c_str(), weightRequest.size(), 0);
+                    bool saved = true;
+                    co_await conn.offload(pool, [&]()
+                                          {
+                        Graph graph(adjMat);
+                        GraphStore::CheckpointTicket ticket = 0;
+                        {
+                            std::lock_guard<std::mutex> lock(current->mutex);
+                            current->graph = graph; // Replace the graph the client works on
+                            current->version++;
+                            current->mstCache.clear();
+                            current->recharge();
+                            if (current->store)
+                                ticket = current->store->beginCheckpoint(true);
+                        }
+                        if (ticket)
+                            saved = checkpoint(*current->store, graph, ticket); });
+                    std::string Message_back = saved ? "Graph created successfully!\n" : "Graph created, but it could not be saved\n";
+                    co_await conn.send(Message_back);
+                    break;
+                }
+                case 2:
+                { // Add an edge to the graph
+                    std::string Edge_Request = "Provide the edge to add (from, to, weight): ";
+                    co_await conn.send(Edge_Request);
+
+                    std::string edgeBuffer;
+                    co_await conn.receive(edgeBuffer); // Read the edge details (from, to, weight)
+
+                    std::istringstream edgeStream(edgeBuffer);
+                    int vertex1, Edge2;
+                    Weight weight;
+                    edgeStream >> vertex1 >> Edge2>> weight;
+
+                    bool durable = true; // Add the edge to the graph
+                    co_await applyMutation(conn, pool, current, Mutation{Mutation::AddEdge, vertex1, Edge2, weight}, durable);
+                    std::string Message_back = durable ? "Edge added successfully!\n" : "Edge added, but the change could not be logged\n";
+                    co_await conn.send(Message_back);
+                    break;
+                }
+                case 3:
+                { // Remove an edge from the graph
+                    std::string Remoe_Edge_Request = "Provide the edge to remove (from, to): ";
+                    co_await conn.send(Remoe_Edge_Request);
+
+                    std::string edgeBuffer;
+                    co_await conn.receive(edgeBuffer); // Read the edge details (from, to)
+
+                    std::istringstream edgeStream(edgeBuffer);
+                    int vertex1, vertex2;
+                    edgeStream >> vertex1 >> vertex2;
+
+                    bool durable = true; // Remove the edge from the graph
+                    co_await applyMutation(conn, pool, current, Mutation{Mutation::RemoveEdge, vertex1, vertex2}, durable);
+                    std::string response = durable ? "Edge removed successfully!\n" : "Edge removed, but the change could not be logged\n";
+                    co_await conn.send(response);
+                    break;
+                }
+                case 4:
+                {                                  // Get the total weight of the MST
+                    Weight weight = 0;
+                    co_await conn.offload(pool, [&]()
+                                          {
+                        auto mst = kruskalTree(current, pool, arena.resource()); // Use Kruskal's algorithm to create the MST
+                        weight = mst->getWieghtMst(); });
+                    std::string response = "Total weight of MST: " + std::to_string(weight) + "\n";
+                    co_await conn.send(response);
+                    break;
+                }
+                case 5:
+                { // Get the longest path in the MST
+                    std::string longest_path_Request = "Provide the start and end vertices for the longest path: ";
+                    co_await conn.send(longest_path_Request);
+
+                    std::string pathBuffer;
+                    co_await conn.receive(pathBuffer); // Read the start and end vertices
+
+                    std::istringstream pathStream(pathBuffer);
+                    int vertex1, vertex2;
+                    pathStream >> vertex1 >> vertex2;
+                    co_await conn.offload(pool, [&]()
+                                          {
+                        auto mst = kruskalTree(current, pool, arena.resource());
+                        rows = std::make_unique<ArraySerializer>(mst->longestPath(vertex1, vertex2)); });
+                    header = "Longest path in MST: ";
+                    break;
+                }
+                case 6:
+                { // Get the shortest path in the MST
+                    std::string shortest_path_Request= "Provide the start and end vertices for the shortest path: ";
+                    co_await conn.send(shortest_path_Request);
+
+                    std::string pathBuffer;
+                    co_await conn.receive(pathBuffer); // Read the start and end vertices
+
+                    std::istringstream pathStream(pathBuffer);
+                    int vertex1, vertex2;
+                    pathStream >> vertex1 >> vertex2;
+
+                    co_await conn.offload(pool, [&]()
+                                          {
+                        auto mst = kruskalTree(current, pool, arena.resource());
+                        rows = std::make_unique<ArraySerializer>(mst->shortestPath(vertex1, vertex2)); });
+                    header = "Shortest path from " + std::to_string(vertex1) + " to " + std::to_string(vertex2) + ": ";
+                    break;
+                }
+                case 7:
+                { // Get the average distance in the MST (as an integer)
+                    Weight avgDist = 0;
+                    co_await conn.offload(pool, [&]()
+                                          {
+                        auto mst = kruskalTree(current, pool, arena.resource());
+                        avgDist = mst->averageDist(); });
+                    std::string response = "Average distance in MST: " + std::to_string(avgDist) + "\n";
+                    co_await conn.send(response);
+                    break;
+                }
+                case 18:
+                { // Aggregate the distances between all pairs of vertices in one pass over the tree
+                    std::string response;
+                    co_await conn.offload(pool, [&]()
+                                          {
+                        auto mst = kruskalTree(current, pool, arena.resource());
+                        response = mst->pairDistances().report(); });
+                    co_await conn.send(response);
+                    break;
+                }
+                case 8:
+                case 10:
+                case 11:
+                { // Print the MST as an adjacency matrix, an edge list or a parent array
+                    co_await conn.offload(pool, [&]()
+                                          {
+                        mst = kruskalTree(current, pool, arena.resource());
+                        if (choice == 8)
+                            rows = std::make_unique<RowSerializer>(mst->getNumVertices(), mst->getNumVertices(),
+                                                                   [tree = mst.get()](size_t u, Weight *row)
+                                                                   { tree->matrixRow(u, row); });
+                        else if (choice == 10)
+                            rows = std::make_unique<EdgeListSerializer>(mst->edgeList());
+                        else
+                            rows = std::make_unique<ArraySerializer>(mst->parentArray(0)); });
+                    header = choice == 8 ? "MST Matrix:\n" : choice == 10 ? "MST Edges (u v w):\n" : "MST Parent Array:\n";
+                    break;
+                }
+                case 9:
+                {                        // Exit the client connection
+                    conn.close(); // Close the connection
+                    co_return;
+                }
+                case 17:
+                { // Answer a batch of path queries from one tree, on the pool as the batches are formatted
+                    std::string Count_Request = "Enter the number of pairs: ";
+                    co_await conn.send(Count_Request);
+
+                    std::string countBuffer;
+                    co_await conn.receive(countBuffer); // Read the number of pairs
+                    long count = 0;
+                    std::istringstream(countBuffer) >> count;
+                    if (count <= 0 || static_cast<size_t>(count) > MAX_BATCH_PAIRS)
+                    {
+                        std::string errorMsg = "Error: The number of pairs must be 1 to " + std::to_string(MAX_BATCH_PAIRS) + "\n";
+                        co_await conn.send(errorMsg);
+                        break;
+                    }
 
-                    char rowBuffer[1024] = {0};
-                    read(CSocket, rowBuffer, 1024);
+                    std::string Pairs_Request = "Provide the pairs (source end), any number per line: ";
+                    co_await conn.send(Pairs_Request);
+                    PairReader reader(count);
+                    bool valid = true;
+                    std::string pairsBuffer;
+                    while (valid && !reader.complete()) // The pairs may take many reads
+                    {
+                        bool received = co_await conn.receive(pairsBuffer);
+                        valid = received && reader.feed(pairsBuffer);
+                    }
+                    if (!reader.complete())
+                    {
+                        std::string errorMsg = "Error: Invalid input format! Provide pairs of integers (source, end).\n";
+                        co_await conn.send(errorMsg);
+                        break;
+                    }
 
-                    std::istringstream rowStream(rowBuffer);
-                    for (int j = 0; j < numVertices; ++j)
+                    std::vector<std::pair<int, int>> pairs = reader.take();
+                    std::string error;
+                    co_await conn.offload(pool, [&]()
+                                          {
+                        std::shared_ptr<MST> tree = kruskalTree(current, pool, arena.resource());
+                        size_t invalid = firstInvalidPair(pairs, tree->getNumVertices());
+                        if (invalid < pairs.size())
+                            error = "Error: Vertex index is invalid in pair " + std::to_string(invalid + 1) + ".\n";
+                        else
+                            rows = std::make_unique<PathBatch>(std::move(tree), std::move(pairs), &pool); });
+                    if (!error.empty())
                     {
-                        rowStream >> adjMat[i][j]; // Fill adjacency matrix from client's input
+                        co_await conn.send(error);
+                        break;
                     }
+                    header = "Paths of " + std::to_string(count) + " pairs (source end weight: path):\n";
+                    break;
                 }
-
-                *Pointer_Graph = Graph(adjMat); // Assign the new graph to Pointer_Graph
-                std::string Message_back = "Graph created successfully!\n";
-                send(CSocket, Message_back.c_str(), Message_back.size(), 0);
-                break;
-            }
-            case 2:
-            { // Add an edge to the graph
-                std::string Edge_Request = "Provide the edge to add (from, to, weight): ";
-                send(CSocket, Edge_Request.c_str(), Edge_Request.size(), 0);
-
-                char edgeBuffer[1024] = {0};
-                read(CSocket, edgeBuffer, 1024); // Read the edge details (from, to, weight)
-
-                std::istringstream edgeStream(edgeBuffer);
-                int vertex1, Edge2, weight;
-                edgeStream >> vertex1 >> Edge2>> weight;
-
-                Pointer_Graph->addEdge(vertex1, Edge2, weight); // Add the edge to the graph
-                std::string Message_back = "Edge added successfully!\n";
-                send(CSocket, Message_back.c_str(), Message_back.size(), 0);
-                break;
-            }
-            case 3:
-            { // Remove an edge from the graph
-                std::string Remoe_Edge_Request = "Provide the edge to remove (from, to): ";
-                send(CSocket, Remoe_Edge_Request.c_str(), Remoe_Edge_Request.size(), 0);
-
-                char edgeBuffer[1024] = {0};
-                read(CSocket, edgeBuffer, 1024); // Read the edge details (from, to)
-
-                std::istringstream edgeStream(edgeBuffer);
-                int vertex1, vertex2;
-                edgeStream >> vertex1 >> vertex2;
-
-                Pointer_Graph->removeEdge(vertex1, vertex2); // Remove the edge from the graph
-                std::string response = "Edge removed successfully!\n";
-                send(CSocket, response.c_str(), response.size(), 0);
-                break;
-            }
-            case 4:
-            {                                  // Get the total weight of the MST
-                MST mst(*Pointer_Graph, "kruskal"); // Use Kruskal's algorithm to create the MST
-                int weight = mst.getWieghtMst();
-                std::string response = "Total weight of MST: " + std::to_string(weight) + "\n";
-                send(CSocket, response.c_str(), response.size(), 0);
-                break;
-            }
-            case 5:
-            { // Get the longest path in the MST
-                std::string longest_path_Request = "Provide the start and end vertices for the longest path: ";
-                send(CSocket, longest_path_Request.c_str(), longest_path_Request.size(), 0);
-
-                char pathBuffer[1024] = {0};
-                read(CSocket, pathBuffer, 1024); // Read the start and end vertices
-
-                std::istringstream pathStream(pathBuffer);
-                int vertex1, vertex2;
-                pathStream >> vertex1 >> vertex2;
-                MST mst(*Pointer_Graph, "kruskal");
-                std::vector<int> path = mst.longestPath(vertex1, vertex2);
-                std::string response = "Longest path in MST: ";
-                for (int v : path)
-                {
-                    response += std::to_string(v) + " ";
+                case 12:
+                case 13:
+                case 14:
+                { // Create, select or drop a named graph
+                    std::string Name_Request = "Enter the graph name: ";
+                    co_await conn.send(Name_Request);
+
+                    std::string nameBuffer;
+                    co_await conn.receive(nameBuffer); // Read the graph name
+                    std::string name;
+                    std::istringstream(nameBuffer) >> name;
+
+                    std::string response;
+                    co_await conn.offload(pool, [&]()
+                                          {
+                        try
+                        {
+                            if (choice == 12)
+                            {
+                                current = registry.create(name);
+                                graphName = name;
+                                response = "Graph " + name + " created and selected\n";
+                            }
+                            else if (choice == 13)
+                            {
+                                auto found = registry.find(name);
+                                if (!found)
+                                    throw std::invalid_argument("No graph named " + name);
+                                current = std::move(found);
+                                graphName = name;
+                                response = "Graph " + name + " selected\n";
+                            }
+                            else
+                            {
+                                registry.drop(name);
+                                response = "Graph " + name + " dropped\n";
+                                if (name == graphName)
+                                {
+                                    graphName = GraphRegistry::DEFAULT_GRAPH;
+                                    current = registry.find(graphName);
+                                    response = "Graph " + name + " dropped, back on the default graph\n";
+                                }
+                            }
+                        }
+                        catch (const std::exception &e)
+                        {
+                            response = std::string("Error: ") + e.what() + "\n";
+                        } });
+                    co_await conn.send(response);
+                    break;
+                }
+                case 15:
+                { // List the graphs, marking the one the client works on
+                    std::string response = "Graphs:\n";
+                    for (const std::string &name : registry.names())
+                        response += name + (name == graphName ? " (selected)\n" : "\n");
+                    co_await conn.send(response);
+                    break;
+                }
+                case 16:
+                { // Show how much memory the graphs take
+                    std::string response = memoryBudget->report();
+                    co_await conn.send(response);
+                    break;
+                }
+                default:
+                { // Invalid choice handling
+                    std::string errorMsg = "Invalid choice. Please try again.\n";
+                    co_await conn.send(errorMsg);
+                    break;
                 }
-                response += "\n";
-                send(CSocket, response.c_str(), response.size(), 0);
-                break;
-            }
-            case 6:
-            { // Get the shortest path in the MST
-                std::string shortest_path_Request= "Provide the start and end vertices for the shortest path: ";
-                send(CSocket, shortest_path_Request.c_str(), shortest_path_Request.size(), 0);
-
-                char pathBuffer[1024] = {0};
-                read(CSocket, pathBuffer, 1024); // Read the start and end vertices
-
-                std::istringstream pathStream(pathBuffer);
-                int vertex1, vertex2;
-                pathStream >> vertex1 >> vertex2;
-
-                MST mst(*Pointer_Graph, "kruskal");
-                auto path = mst.shortestPath(vertex1, vertex2);
-
-                std::string response = "Shortest path from " + std::to_string(vertex1) + " to " + std::to_string(vertex2) + ": ";
-                for (int v : path)
-                {
-                    response += std::to_string(v) + " ";
                 }
-                response += "\n";
-                send(CSocket, response.c_str(), response.size(), 0);
-                break;
-            }
-            case 7:
-            { // Get the average distance in the MST (as an integer)
-                MST mst(*Pointer_Graph, "kruskal");
-                int avgDist = static_cast<int>(mst.averageDist());
-                std::string response = "Average distance in MST: " + std::to_string(avgDist) + "\n";
-                send(CSocket, response.c_str(), response.size(), 0);
-                break;
-            }
-            case 8:
-            { // Print the MST (adjacency matrix format)
-                MST mst(*Pointer_Graph, "kruskal");
-                std::stringstream mstStream;
-                auto mstMatrix = mst.getMST();
 
-                for (const auto &row : mstMatrix)
+                // Format and send a streamed result one batch at a time, so it never exists whole
+                if (rows)
                 {
-                    for (const auto &val : row)
+                    ChunkWriter response;
+                    response.setChunked(chunkedResponses);
+                    response.append(header);
+                    bool more = true, sent = true;
+                    while (more && sent)
                     {
-                        mstStream << val << " ";
+                        co_await conn.offload(pool, [&]()
+                                              {
+                            more = rows->next(response, RESPONSE_BATCH);
+                            if (!more)
+                                response.finish(); });
+                        sent = co_await conn.send(response);
                     }
-                    mstStream << "\n";
                 }
-                std::string response = "MST Matrix:\n" + mstStream.str();
-                send(CSocket, response.c_str(), response.size(), 0);
-                break;
-            }
-            case 9:
-            {                        // Exit the client connection
-                close(CSocket); // Close the connection
-                return;
-            }
-            default:
-            { // Invalid choice handling
-                std::string errorMsg = "Invalid choice. Please try again.\n";
-                send(CSocket, errorMsg.c_str(), errorMsg.size(), 0);
-                break;
             }
+            catch (const std::exception &e)
+            {
+                failure = std::string("Error: ") + e.what() + "\n";
             }
-
-            memset(buffer, 0, sizeof(buffer)); // Clear buffer for the next loop
+            if (!failure.empty())
+                co_await conn.send(failure);
+            mst.reset();
+            arena.reset();
         }
     }
 
-public:
-    LeaderFollowerThreadPool() : stopFlag(false)
+    LeaderFollowerThreadPool(size_t numThreads, bool adaptive) : sessions(numThreads), pool(numThreads, adaptive)
     {
-        // Create worker threads and assign the workerLoop function to each thread
-        for (int i = 0; i < THREAD_POOL_SIZE; ++i)
-        {
-            workers.emplace_back([this]()
-                                 { this->workerLoop(); });
-        }
     }
-    // Destructor to clean up the thread pool
-    ~LeaderFollowerThreadPool()
+
+    // Function to start a new client session: blocking sessions wait for a session worker,
+    // event-loop sessions start right away on the loop thread this is called from. Sessions
+    // never run on the MST pool, whose workers would otherwise be held for a whole session.
+    void addTask(Task task)
     {
-        // Set the stop flag and notify all threads to stop
+        if (task.Loop)
         {
-            std::unique_lock<std::mutex> lock(queueMutex);
-            stopFlag = true;
-        }
-        cv.notify_all(); // Notify all threads to wake up and stop
-        for (auto &worker : workers)
-        {
-            worker.join(); // Join each worker thread
+            Menue_process(Connection(task.CSocket, task.Loop), *task.Registry, pool);
+            return;
         }
+        sessions.submit([this, task]()
+                        { Menue_process(Connection(task.CSocket), *task.Registry, pool); });
     }
 
-    // Function to process the tasks in the task queue
-    void workerLoop()
+    // Function to run fine-grained work on the MST pool
+    WorkStealingPool &scheduler()
     {
-        while (true)
-        {
-            Task task;
-            {
-                std::unique_lock<std::mutex> lock(queueMutex);
-                cv.wait(lock, [this]()
-                        { return !tasks.empty() || stopFlag; }); // Wait for a task or stop signal
-                if (stopFlag && tasks.empty())
-                    return; // Exit loop if stopFlag is set and no more tasks
-                task = tasks.front();
-                tasks.pop(); // Get the next task
-            }
-            Menue_process(task.CSocket, task.Pointer_Graph); // Process the task
-        }
+        return pool;
     }
+};
 
-    // Function to add a new task to the task queue
-    void addTask(Task task)
+// Function: loadGraphs
+// Loads the graphs saved at the --graph file, if there is one; exits if they cannot be loaded.
+static void loadGraphs(GraphRegistry &registry, const ServerConfig &config)
+{
+    if (config.graphFile.empty())
+        return;
+    try
     {
-        {
-            std::unique_lock<std::mutex> lock(queueMutex);
-            tasks.push(task); // Add the task to the queue
-            cv.notify_one();  // Notify one worker thread to process the task
-        }
+        for (const auto &[name, replayed] : registry.load())
+            std::cout << "Loaded graph " << name << " of " << registry.find(name)->graph.getNumVertices()
+                      << " vertices from " << config.graphFile << " and replayed " << replayed << " logged changes\n";
     }
-};
+    catch (const std::runtime_error &e)
+    {
+        std::cerr << e.what() << "\n";
+        exit(EXIT_FAILURE);
+    }
+}
 
 /**
  * Main function: Initializes the server and sets up the thread pool for handling clients.
+ * Port, backlog and pool size come from the command line (see serverUsage).
  */
-int main()
+int main(int argc, char *argv[])
 {
+    ServerConfig config;
+    try
+    {
+        config = parseServerConfig(argc, argv, ServerConfig{PORT, 3, THREAD_POOL_SIZE});
+    }
+    catch (const std::invalid_argument &e)
+    {
+        std::cerr << e.what() << "\n" << serverUsage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    chunkedResponses = config.chunked;
+
+    if (config.reusePort)
+    {
+        // One listener, event loop and worker set per core; sessions run as coroutines on their shard's loop,
+        // or with blocking I/O on a thread of their own so a slow client never holds a shard's workers
+        MemoryBudget budget(config.memoryBudget);
+        memoryBudget = &budget;
+        GraphRegistry registry(config.graphFile, &budget);
+        loadGraphs(registry, config);
+        try
+        {
+            bool blocking = config.ioBackend == IoBackendKind::Blocking;
+            ShardedAcceptor acceptor(config, [&registry, blocking](int clientSocket, EventLoop &shardLoop, WorkStealingPool &shardPool)
+                                     {
+                std::cout << "Accepted new client\n";
+                if (blocking)
+                {
+                    std::thread([clientSocket, &registry, &shardPool]()
+                                { LeaderFollowerThreadPool::Menue_process(Connection(clientSocket), registry, shardPool); })
+                        .detach();
+                    return;
+                }
+                shardLoop.attach(clientSocket);
+                LeaderFollowerThreadPool::Menue_process(Connection(clientSocket, &shardLoop), registry, shardPool); });
+            shardedAcceptor = &acceptor;
+            std::cout << "Server is running with " << acceptor.shardCount() << " shards. Waiting for clients...\n";
+            acceptor.run();
+            shardedAcceptor = nullptr;
+        }
+        catch (const std::runtime_error &e)
+        {
+            std::cerr << e.what() << "\n";
+            exit(EXIT_FAILURE);
+        }
+        return 0;
+    }
 
     int serverFd, newSocket;
     struct sockaddr_in address;
@@ -337,7 +687,7 @@ int main()
     // Set up the server address and port
     address.sin_family = AF_INET;         // IPv4
     address.sin_addr.s_addr = INADDR_ANY; // Accept connections from any IP
-    address.sin_port = htons(PORT);       // Bind to the specified port
+    address.sin_port = htons(config.port); // Bind to the configured port
 
     // Bind the socket to the address and port
     if (bind(serverFd, (struct sockaddr *)&address, sizeof(address)) < 0)
@@ -347,8 +697,8 @@ int main()
         exit(EXIT_FAILURE);
     }
 
-    // Start listening for client connections (with a backlog of 3 clients)
-    if (listen(serverFd, 3) < 0)
+    // Start listening for client connections
+    if (listen(serverFd, config.backlog) < 0)
     {
         std::cerr << "Listen failed\n";
         close(serverFd);
@@ -356,8 +706,33 @@ int main()
     }
 
     // Initialize the Leader-Follower thread pool
-    LeaderFollowerThreadPool threadPool;
-    Graph graph(std::vector<std::vector<int>>{}); // Create an empty graph
+    LeaderFollowerThreadPool threadPool(config.threads, config.adaptive);
+    MemoryBudget budget(config.memoryBudget); // Declared first: the graphs hold charges of it
+    memoryBudget = &budget;
+    GraphRegistry registry(config.graphFile, &budget); // Only the empty default graph, unless --graph names saved ones
+    loadGraphs(registry, config);
+
+    if (config.ioBackend != IoBackendKind::Blocking)
+    {
+        // Accepts and socket I/O of all sessions go through one event loop on the main thread
+        EventLoop loop(config.ioBackend);
+        eventLoop = &loop;
+        loop.listen(serverFd, [&](int clientSocket)
+                    {
+            if (clientSocket < 0)
+            {
+                std::cerr << "Accept failed: " << strerror(-clientSocket) << "\n";
+                return;
+            }
+            std::cout << "Accepted new client\n";
+            loop.attach(clientSocket);
+            threadPool.addTask(Task{clientSocket, &registry, &loop}); });
+        std::cout << "Server is running with " << loop.backendName() << " I/O. Waiting for clients...\n";
+        loop.run();
+        eventLoop = nullptr;
+        close(serverFd);
+        return 0;
+    }
 
     std::cout << "Server is running. Waiting for clients...\n";
 
@@ -365,7 +740,7 @@ int main()
     while ((newSocket = accept(serverFd, (struct sockaddr *)&address, (socklen_t *)&addrlen)) >= 0)
     {
         std::cout << "Accepted new client\n";
-        Task newTask{newSocket, &graph}; // Create a new task for each client
+        Task newTask{newSocket, &registry}; // Create a new task for each client
         threadPool.addTask(newTask);     // Add the task to the thread pool
         if(close_server)
         {
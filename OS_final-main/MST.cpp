@@ -5,109 +5,219 @@
 #include <queue>
 #include <algorithm>
 #include <limits>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
 
 using namespace std;
 
-// Constructor
-MST::MST(Graph graph, string type) : graph(graph)
+// Below this many vertices a parallel scan costs more than it saves
+static const int PARALLEL_MIN_VERTICES = 256;
+
+// A row with fewer edges than 1 in SPARSE_ROW_FRACTION of its cells is walked by the set bits of
+// the graph's edge bitset. Denser rows go through the vector kernels, which step over 16 cells
+// at a time whether they hold edges or not.
+static const int SPARSE_ROW_FRACTION = 32;
+
+static bool sparseRow(int edges, int cells)
 {
-    vector<vector<int>> adjmat = graph.getAdjMat();
-    int i = adjmat.size();
-    if (i == 0)
-    {
-        mst = vector<vector<int>>();
-    }
-    mst = vector<vector<int>>(i, vector<int>(i, 0));
+    return edges * SPARSE_ROW_FRACTION < cells;
+}
+
+// Weight type of Kruskal's sort keys: int unless the cells hold weights beyond it, so the
+// edges of the common graphs sort as 12-byte tuples instead of 16-byte ones
+template <typename Cell>
+using SortWeight = conditional_t<is_same_v<Cell, uint32_t> || is_same_v<Cell, Weight>, Weight, int>;
 
-    if (type =="kruskal")
+// this is a class for the union-find forest of the MST algorithms, by rank with path halving.
+// find() climbs in a loop rather than recursing through a std::function, so it inlines into
+// the edge loops.
+class DisjointSets
+{
+public:
+    DisjointSets(int n, std::pmr::memory_resource *scratch) : parent(n, scratch), rank(n, 0, scratch)
     {
-        kruskal(adjmat);
+        for (int i = 0; i < n; i++)
+            parent[i] = i;
     }
-    else if (type =="boruvka")
+
+    int find(int x)
     {
-        boruvka(adjmat);
+        while (parent[x] != x)
+        {
+            parent[x] = parent[parent[x]]; // Point every other vertex on the path at its grandparent
+            x = parent[x];
+        }
+        return x;
     }
-    else
+
+    // Joins the sets of x and y; false if they are one set already
+    bool unite(int x, int y)
     {
-        cout << "Invalid algorithm" << endl;
+        x = find(x);
+        y = find(y);
+        if (x == y)
+            return false;
+        if (rank[x] < rank[y])
+            swap(x, y);
+        parent[y] = x;
+        if (rank[x] == rank[y])
+            rank[x]++;
+        return true;
     }
+
+private:
+    std::pmr::vector<int> parent;
+    std::pmr::vector<int> rank;
+};
+
+optional<MstAlgorithm> parseMstAlgorithm(const string &name)
+{
+    if (name == "kruskal")
+        return MstAlgorithm::Kruskal;
+    if (name == "boruvka")
+        return MstAlgorithm::Boruvka;
+    return nullopt;
 }
-// Function to get the weight of the MST
-int MST::getWieghtMst()
+
+// Constructor
+MST::MST(const Graph &graph, MstAlgorithm algorithm, WorkStealingPool *pool, std::pmr::memory_resource *scratch) : pool(pool)
 {
-    if (mst.empty())
-        return 0;
-    int weight = 0;
-    for (size_t i = 0; i < mst.size(); i++)
-    {
-        for (size_t j = i + 1; j < mst[i].size(); j++)
+    build(graph, algorithm, scratch);
+}
+
+MST::MST(const Graph &graph, string type, WorkStealingPool *pool, std::pmr::memory_resource *scratch) : pool(pool)
+{
+    build(graph, parseMstAlgorithm(type), scratch);
+}
+
+/**
+ * build
+ * The runtime dispatcher: picks the engine for the algorithm and the cell type of the graph's
+ * weights once. Each engine is compiled for its cell type, with the union-find, the
+ * comparisons and the edge iteration inlined, so nothing inside the loops dispatches again.
+ *
+ * @param algorithm The algorithm; without one the tree stays empty.
+ */
+void MST::build(const Graph &graph, optional<MstAlgorithm> algorithm, std::pmr::memory_resource *scratch)
+{
+    graph.visitAdjMat([&](const auto &adjmat)
+                      {
+        vertexCount = adjmat.size();
+
+        if (!algorithm)
         {
-            weight += mst[i][j];
+            cout << "Invalid algorithm" << endl;
+            return;
         }
-    }
+        switch (*algorithm)
+        {
+        case MstAlgorithm::Kruskal:
+            kruskal(adjmat, graph.getEdgeBits(), scratch);
+            break;
+        case MstAlgorithm::Boruvka:
+            boruvka(adjmat, graph.getEdgeBits(), graph.isSymmetric(), scratch);
+            break;
+        } });
+    sort(treeEdges.begin(), treeEdges.end());
+    buildTree();
+}
+// Function to get the weight of the MST
+Weight MST::getWieghtMst()
+{
+    Weight weight = 0;
+    for (const auto &[u, v, w] : treeEdges)
+        weight += w;
     return weight;
 }
 
 /**
  * getMST
- * Returns the adjacency matrix of the MST.
+ * Builds the adjacency matrix form of the MST. The tree itself is not kept as a matrix,
+ * so this costs O(V^2) time and memory on every call.
  *
  * @return The MST adjacency matrix.
  */
-vector<vector<int>> MST::getMST()
+FlatMatrix<Weight> MST::getMST() const
+{
+    FlatMatrix<Weight> matrix(vertexCount, vertexCount);
+    for (const auto &[u, v, w] : treeEdges)
+        matrix[u][v] = matrix[v][u] = w;
+    return matrix;
+}
+
+/**
+ * matrixRow
+ * Writes row u of the MST adjacency matrix: the weights of the edges to u's parent and
+ * children, zero elsewhere.
+ *
+ * @param u The vertex.
+ * @param row Room for getNumVertices() values.
+ */
+void MST::matrixRow(int u, Weight *row) const
 {
-    return mst;
+    fill_n(row, vertexCount, 0);
+    if (parent[u] != -1)
+        row[parent[u]] = parentWeight[u];
+    for (int k = childStart[u]; k < childStart[u + 1]; k++)
+        row[children[k]] = parentWeight[children[k]];
 }
 
 // Function to calculate the average distance of all edges in the MST
-void MST::kruskal(vector<vector<int>> &adj)
+template <typename Cell>
+void MST::kruskal(const FlatMatrix<Cell> &adj, const BitMatrix &edgeBits, std::pmr::memory_resource *scratch)
 {
     if (adj.empty())
         return;
     int n = adj.size();
-    vector<tuple<int, int, int>> edges;
 
-    // Collect all edges with weights into a list of tuples
-    for (int i = 0; i < n; i++)
+    // Collect the edges of the upper triangle into (weight, u, v) tuples. A first pass counts
+    // every row's edges with popcounts over the edge bitset, so the buffer is allocated once and
+    // each row knows where its edges go. The fill pass walks the set bits of sparse rows and
+    // compacts dense ones with the vectorized kernel. Both passes run rows in parallel on the pool.
+    auto forRows = [&](auto &&body)
     {
-        for (int j = i + 1; j < n; j++)
+        if (pool && pool->size() > 1 && n >= PARALLEL_MIN_VERTICES)
+            pool->parallelFor(0, n, max<size_t>(n / (pool->size() * 8), 16), body);
+        else
+            body(0, n);
+    };
+    std::pmr::vector<size_t> offset(n + 1, 0, scratch);
+    forRows([&](size_t lo, size_t hi)
+            {
+        for (size_t i = lo; i < hi; i++)
+            offset[i + 1] = edgeBits.count(i, i + 1, n); });
+    for (int i = 0; i < n; i++)
+        offset[i + 1] += offset[i];
+
+    std::pmr::vector<tuple<SortWeight<Cell>, int, int>> edges(offset[n], scratch);
+    forRows([&](size_t lo, size_t hi)
+            {
+        vector<int> cols(n + EDGE_COLUMNS_SLACK); // Per block: the arena behind scratch is not thread-safe
+        for (size_t i = lo; i < hi; i++)
         {
-            if (adj[i][j] > 0)
+            const Cell *row = adj[i];
+            auto out = edges.begin() + offset[i];
+            if (sparseRow(offset[i + 1] - offset[i], n - i - 1))
             {
-                edges.emplace_back(adj[i][j], i, j);
+                edgeBits.forEach(i, i + 1, n, [&](size_t j)
+                                 { *out++ = {row[j], (int)i, (int)j}; });
+                continue;
             }
-        }
-    }
+            int count = edgeColumns(row, i + 1, n, cols.data());
+            for (int k = 0; k < count; k++)
+                out[k] = {row[cols[k]], (int)i, cols[k]};
+        } });
 
     sort(edges.begin(), edges.end());
 
-    vector<int> parent(n);
-    for (int i = 0; i < n; i++)
-        parent[i] = i;
-
-    function<int(int)> find = [&](int x)
-    {
-        if (parent[x] != x)
-            parent[x] = find(parent[x]);
-        return parent[x];
-    };
-
-    auto unite = [&](int x, int y)
-    {
-        x = find(x);
-        y = find(y);
-        if (x != y)
-            parent[y] = x;
-    };
+    DisjointSets sets(n, scratch);
 
     // Add edges to MST, avoiding cycles
     for (const auto &[w, u, v] : edges)
     {
-        if (find(u) != find(v))
-        {
-            unite(u, v);
-            mst[u][v] = mst[v][u] = w;
-        }
+        if (sets.unite(u, v))
+            treeEdges.emplace_back(u, v, w); // u < v, edges come from the upper triangle
     }
 }
 
@@ -116,72 +226,109 @@ void MST::kruskal(vector<vector<int>> &adj)
  * Constructs the MST using Borůvka's algorithm, which finds the cheapest edge
  * for each component and merges components until only one remains.
  *
- * @param adj The adjacency matrix of the input graph.
+ * @param adj The adjacency matrix of the input graph, in any of its cell types.
+ * @param edgeBits The graph's edge bitset; sparse rows are scanned through its set bits.
+ * @param symmetric Whether every edge is stored in both rows; then each row is searched
+ *                  with the vectorized cheapestInRow kernel.
+ * @param scratch Where the union-find and cheapest-edge arrays are allocated.
  */
 
-void MST::boruvka(vector<vector<int>> &adj)
+template <typename Cell>
+void MST::boruvka(const FlatMatrix<Cell> &adj, const BitMatrix &edgeBits, bool symmetric, std::pmr::memory_resource *scratch)
 {
     // Check if the adjacency matrix is empty (no vertices)
     if (adj.empty())
         return;
 
     int n = adj.size(); // Number of vertices in the graph
-    vector<int> parent(n); // Array to keep track of the parent of each node for union-find
-    vector<int> rank(n, 0); // Rank array for union by rank in union-find
+    DisjointSets sets(n, scratch); // Components merged so far
 
-    // Initialize each vertex to be its own parent (self-loop) initially
+    // Edges per row, fixed for the whole run
+    std::pmr::vector<int> rowEdges(n, scratch);
     for (int i = 0; i < n; i++)
-        parent[i] = i;
-
-    // Function to find the root of a node with path compression
-    function<int(int)> find = [&](int x) {
-        if (parent[x] != x)
-            parent[x] = find(parent[x]); // Path compression
-        return parent[x];
-    };
-
-    // Function to union two sets by rank
-    auto unite = [&](int x, int y) {
-        x = find(x);
-        y = find(y);
-        if (x == y) // If both vertices are in the same set, return false
-            return false;
-        if (rank[x] < rank[y]) // Union by rank
-            swap(x, y);
-        parent[y] = x; // Make x the parent of y
-        if (rank[x] == rank[y])
-            rank[x]++; // Increment rank if both have the same rank
-        return true;
-    };
+        rowEdges[i] = edgeBits.count(i, 0, n);
+
+    // The working arrays of a round are allocated once and reset in place: scratch is usually
+    // a monotonic arena, which would keep every round's copies until the request ends
+    std::pmr::vector<int> comp(n, scratch);                            // Component of every vertex
+    std::pmr::vector<pair<int, int>> cheapest(n, {-1, -1}, scratch); // Cheapest edge leaving each component
+    bool parallel = pool && pool->size() > 1 && n >= PARALLEL_MIN_VERTICES;
+    size_t grain = parallel ? max<size_t>(n / (pool->size() * 4), 16) : n;
+    size_t blocks = parallel ? (n + grain - 1) / grain : 0;
+    // Every block of rows gets its own cheapest array, merged afterwards. Allocated up front on
+    // this thread: the arena behind scratch is not thread-safe
+    std::pmr::vector<std::pmr::vector<pair<int, int>>> partial(blocks, std::pmr::vector<pair<int, int>>(n, {-1, -1}, scratch), scratch);
 
     bool change = true; // Flag to track if we added any edges in the current iteration
 
     // Continue until no more edges can be added to the MST
     while (change) {
         change = false;
-        // Array to store the cheapest edge for each component
-        vector<pair<int, int>> cheapest(n, {-1, -1});
-
-        // Loop through each vertex and find the cheapest outgoing edge for each component
-        for (int i = 0; i < n; i++) {
-            for (int j = 0; j < n; j++) {
-                // If there's an edge between i and j
-                if (adj[i][j] > 0) {
-                    int set1 = find(i); // Find component of vertex i
-                    int set2 = find(j); // Find component of vertex j
+        // Component of every vertex, gathered once so the scan below only reads shared state
+        for (int i = 0; i < n; i++)
+            comp[i] = sets.find(i);
+
+        // Scans rows [lo, hi) and records the cheapest edge leaving each component.
+        // Ties are broken by (weight, lower end, higher end): one order over the undirected edges,
+        // so the result does not depend on how rows are split and matches Kruskal's tree.
+        auto cheaper = [&](int u, int v, const pair<int, int> &best) {
+            if (best.second == -1)
+                return true;
+            Cell w = adj[u][v], bw = adj[best.first][best.second];
+            return w < bw || (w == bw && make_pair(min(u, v), max(u, v)) <
+                                             make_pair(min(best.first, best.second), max(best.first, best.second)));
+        };
+        auto scanRows = [&](size_t lo, size_t hi, std::pmr::vector<pair<int, int>> &cheapest) {
+            for (size_t i = lo; i < hi; i++) {
+                const Cell *row = adj[i]; // Contiguous and cache-line aligned
+                if (symmetric) {
+                    // Every edge leaving a component is in the row of its inside end, so a row
+                    // only has to report the cheapest edge leaving its own component. Within
+                    // a row the lowest column is also the lowest edge in the tie order above.
+                    int own = comp[i], j = -1;
+                    if (sparseRow(rowEdges[i], n)) {
+                        edgeBits.forEach(i, 0, n, [&](size_t k) {
+                            if (comp[k] != own && (j == -1 || row[k] < row[j]))
+                                j = k;
+                        });
+                    } else {
+                        j = cheapestInRow(row, comp.data(), own, n);
+                    }
+                    if (j != -1 && cheaper(i, j, cheapest[own]))
+                        cheapest[own] = {(int)i, j};
+                    continue;
+                }
+                // Only the set bits of the row are edges between i and j
+                edgeBits.forEach(i, 0, n, [&](size_t k) {
+                    int j = k;
+                    int set1 = comp[i]; // Component of vertex i
+                    int set2 = comp[j]; // Component of vertex j
                     // If they are in different components, find the cheaper edge
                     if (set1 != set2) {
-                        // Update cheapest edge for set1 if needed
-                        if (cheapest[set1].second == -1 || adj[i][j] < adj[cheapest[set1].first][cheapest[set1].second]) {
-                            cheapest[set1] = {i, j};
-                        }
-                        // Update cheapest edge for set2 if needed
-                        if (cheapest[set2].second == -1 || adj[i][j] < adj[cheapest[set2].first][cheapest[set2].second]) {
-                            cheapest[set2] = {i, j};
-                        }
+                        if (cheaper(i, j, cheapest[set1]))
+                            cheapest[set1] = {(int)i, j};
+                        if (cheaper(i, j, cheapest[set2]))
+                            cheapest[set2] = {(int)i, j};
                     }
+                });
+            }
+        };
+
+        fill(cheapest.begin(), cheapest.end(), pair<int, int>{-1, -1});
+        if (parallel) {
+            for (auto &block : partial)
+                fill(block.begin(), block.end(), pair<int, int>{-1, -1});
+            pool->parallelFor(0, n, grain, [&](size_t lo, size_t hi) {
+                scanRows(lo, hi, partial[lo / grain]);
+            });
+            for (const auto &block : partial) {
+                for (int c = 0; c < n; c++) {
+                    if (block[c].second != -1 && cheaper(block[c].first, block[c].second, cheapest[c]))
+                        cheapest[c] = block[c];
                 }
             }
+        } else {
+            scanRows(0, n, cheapest);
         }
 
         // Add the cheapest edges found to the MST
@@ -189,12 +336,9 @@ void MST::boruvka(vector<vector<int>> &adj)
             if (cheapest[i].second != -1) { // If there's a valid edge
                 int u = cheapest[i].first;
                 int v = cheapest[i].second;
-                int set1 = find(u);
-                int set2 = find(v);
                 // If u and v are in different components, add edge to MST
-                if (set1 != set2) {
-                    mst[u][v] = mst[v][u] = adj[u][v]; // Add edge (u, v) to MST
-                    unite(set1, set2); // Union the two components
+                if (sets.unite(u, v)) {
+                    treeEdges.emplace_back(min(u, v), max(u, v), adj[u][v]);
                     change = true; // Mark that we made a change
                 }
             }
@@ -204,66 +348,215 @@ void MST::boruvka(vector<vector<int>> &adj)
 
 
 /**
- * shortestPath
- * Finds the shortest path between two nodes in the MST using BFS.
- *
- * @param start The start node.
- * @param end The end node.
- * @return A vector representing the path from start to end, or an empty vector if no path exists.
+ * buildTree
+ * Turns the tree edges into the stored tree: roots it at vertex 0 with a BFS (other
+ * components at their lowest vertex), then groups the children of every vertex in CSR form.
  */
-vector<int> MST::shortestPath(int s, int e)
+void MST::buildTree()
 {
-    std::cout << "shortestPath" << std::endl;
-    if (mst.empty())
-        return {};
-
-    int size = mst.size();
-    std::cout << size << std::endl;
-    vector<int> dist(size, numeric_limits<int>::max());
-    vector<int> parent(size, -1);
-    vector<bool> visited(size, false);
-    priority_queue<pair<int, int>, vector<pair<int, int>>, greater<pair<int, int>>> pq;
+    int n = vertexCount;
+    parent.assign(n, -1);
+    parentWeight.assign(n, 0);
+    depth.assign(n, 0);
+    childStart.assign(n + 1, 0);
+    children.assign(treeEdges.size(), 0);
+
+    // Undirected adjacency of the tree, only needed while rooting it
+    vector<int> start(n + 1, 0);
+    vector<pair<int, Weight>> adj(2 * treeEdges.size()); // (neighbour, weight)
+    for (const auto &[u, v, w] : treeEdges)
+    {
+        start[u + 1]++;
+        start[v + 1]++;
+    }
+    for (int v = 0; v < n; v++)
+        start[v + 1] += start[v];
+    vector<int> fill(start.begin(), start.end() - 1);
+    for (const auto &[u, v, w] : treeEdges)
+    {
+        adj[fill[u]++] = {v, w};
+        adj[fill[v]++] = {u, w};
+    }
 
-    dist[s] = 0;
-    pq.push({0, s});
+    vector<bool> visited(n, false);
+    vector<int> queue;
+    queue.reserve(n);
+    for (int r = 0; r < n; r++)
+    {
+        if (visited[r])
+            continue;
+        visited[r] = true;
+        queue.push_back(r);
+        for (size_t head = queue.size() - 1; head < queue.size(); head++)
+        {
+            int u = queue[head];
+            for (int k = start[u]; k < start[u + 1]; k++)
+            {
+                auto [v, w] = adj[k];
+                if (!visited[v])
+                {
+                    visited[v] = true;
+                    parent[v] = u;
+                    parentWeight[v] = w;
+                    depth[v] = depth[u] + 1;
+                    queue.push_back(v);
+                }
+            }
+        }
+    }
 
-    while (!pq.empty())
+    for (int v = 0; v < n; v++)
+    {
+        if (parent[v] != -1)
+            childStart[parent[v] + 1]++;
+    }
+    for (int v = 0; v < n; v++)
+        childStart[v + 1] += childStart[v];
+    fill.assign(childStart.begin(), childStart.end() - 1);
+    for (int v = 0; v < n; v++)
     {
-        int u = pq.top().second;
-        pq.pop();
+        if (parent[v] != -1)
+            children[fill[parent[v]]++] = v;
+    }
+}
 
-        if (visited[u])
-            continue;
+size_t MST::treeBytes() const
+{
+    return treeEdges.capacity() * sizeof(treeEdges[0]);
+}
 
-        visited[u] = true;
+size_t MST::indexBytes() const
+{
+    return parent.capacity() * sizeof(int) + parentWeight.capacity() * sizeof(Weight) + depth.capacity() * sizeof(int) +
+           childStart.capacity() * sizeof(int) + children.capacity() * sizeof(int);
+}
 
-        for (int v = 0; v < size; v++)
+/**
+ * parentArray
+ * Returns the parent of every vertex with the tree rooted at the given vertex. Rooted at 0
+ * that is the stored tree; any other root is found with a BFS over the tree in O(V).
+ * Roots have parent -1; if the graph is disconnected, every other component is rooted at
+ * its lowest vertex.
+ *
+ * @param root The vertex to root the tree at.
+ * @return parent[v] for every vertex v.
+ */
+vector<int> MST::parentArray(int root) const
+{
+    int n = vertexCount;
+    if (root <= 0 || root >= n)
+        return parent;
+
+    vector<int> rerooted(n, -1);
+    vector<bool> visited(n, false);
+    vector<int> queue;
+    queue.reserve(n);
+    for (int i = -1; i < n; i++)
+    {
+        int r = i < 0 ? root : i;
+        if (visited[r])
+            continue;
+        visited[r] = true;
+        queue.push_back(r);
+        for (size_t head = queue.size() - 1; head < queue.size(); head++)
         {
-            if (mst[u][v] > 0 && !visited[v] && dist[u] + mst[u][v] < dist[v])
+            int u = queue[head];
+            auto visit = [&](int v)
             {
-                dist[v] = dist[u] + mst[u][v];
-                parent[v] = u;
-                pq.push({dist[v], v});
-            }
+                if (!visited[v])
+                {
+                    visited[v] = true;
+                    rerooted[v] = u;
+                    queue.push_back(v);
+                }
+            };
+            if (parent[u] != -1)
+                visit(parent[u]);
+            for (int k = childStart[u]; k < childStart[u + 1]; k++)
+                visit(children[k]);
         }
     }
+    return rerooted;
+}
 
-    if (dist[e] == numeric_limits<int>::max())
-        return {};
+/**
+ * treePathInto
+ * The path between two vertices of the tree: both climb towards the root until they meet
+ * at their lowest common ancestor, in O(path length). Batch queries call it for many pairs
+ * with the same two vectors, so a query allocates nothing once they have grown.
+ *
+ * @param path Set to the vertices from s to e, or emptied if there is no path.
+ * @param scratch Working space: e up to just below the common ancestor.
+ * @return The weight of the path, or -1 if there is none.
+ */
+Weight MST::treePathInto(int s, int e, vector<int> &path, vector<int> &scratch) const
+{
+    path.clear();
+    scratch.clear();
+    if (s < 0 || s >= vertexCount || e < 0 || e >= vertexCount)
+        return -1;
 
-    vector<int> path;
-    for (int v = e; v != -1; v = parent[v])
+    Weight weight = 0;
+    int a = s, b = e;
+    while (depth[a] > depth[b])
+    {
+        path.push_back(a);
+        weight += parentWeight[a];
+        a = parent[a];
+    }
+    while (depth[b] > depth[a])
     {
-        path.push_back(v);
+        scratch.push_back(b);
+        weight += parentWeight[b];
+        b = parent[b];
     }
-    reverse(path.begin(), path.end());
+    while (a != b)
+    {
+        if (parent[a] == -1) // Both reached their roots: different components
+        {
+            path.clear();
+            return -1;
+        }
+        path.push_back(a);
+        scratch.push_back(b);
+        weight += parentWeight[a] + parentWeight[b];
+        a = parent[a];
+        b = parent[b];
+    }
+    path.push_back(a);
+    path.insert(path.end(), scratch.rbegin(), scratch.rend());
+    return weight;
+}
+
+// The vertices from s to e, or an empty vector if they are in different components
+vector<int> MST::treePath(int s, int e) const
+{
+    vector<int> path, scratch;
+    treePathInto(s, e, path, scratch);
     return path;
 }
 
+/**
+ * shortestPath
+ * Finds the shortest path between two nodes in the MST. A tree has exactly one path
+ * between two vertices, so this is the tree path.
+ *
+ * @param start The start node.
+ * @param end The end node.
+ * @return A vector representing the path from start to end, or an empty vector if no path exists.
+ */
+vector<int> MST::shortestPath(int s, int e)
+{
+    if (vertexCount == 0)
+        return {};
+    return treePath(s, e);
+}
+
 
 /**
  * longestPath
- * Finds the longest path between two nodes in the MST using DFS.
+ * Finds the longest simple path between two nodes in the MST. A tree has exactly one
+ * simple path between two vertices, so this is the tree path as well.
  *
  * @param start The start node.
  * @param end The end node.
@@ -271,50 +564,13 @@ vector<int> MST::shortestPath(int s, int e)
  */
 vector<int> MST::longestPath(int s, int e)
 {
-    if (mst.empty())
+    if (vertexCount == 0)
         return {};
 
     if (s == e)
         return {s};
 
-    int size = mst.size();
-    vector<bool> visited(size, false);
-    vector<int> currentPath;
-    vector<int> longestPath;
-    int maxPathLength = 0;  // To track the longest path length
-
-    function<void(int, int)> dfs = [&](int u, int length)
-    {
-        visited[u] = true;
-        currentPath.push_back(u);
-
-        if (u == e)
-        {
-            // Update longest path if current path is longer
-            if (length > maxPathLength)
-            {
-                maxPathLength = length;
-                longestPath = currentPath;
-            }
-        }
-        else
-        {
-            for (int v = 0; v < size; v++)
-            {
-                if (mst[u][v] > 0 && !visited[v])
-                {
-                    dfs(v, length + 1); // Use edge count to measure path length
-                }
-            }
-        }
-
-        currentPath.pop_back();
-        visited[u] = false;
-    };
-
-    dfs(s, 0);
-
-    return longestPath;
+    return treePath(s, e);
 }
 
 
@@ -325,21 +581,15 @@ vector<int> MST::longestPath(int s, int e)
  *
  * @return The average edge distance or -1 if no paths exist in the MST.
  */
-int MST::averageDist() {
-    if (mst.empty())
+Weight MST::averageDist() {
+    if (vertexCount == 0)
         return -1;
 
-    int total = 0;
-    int count = 0;
-    size_t i = mst.size();
-
-    for (size_t s = 0; s < i; ++s) {
-        for (size_t e = s + 1; e<i; ++e) {
-            if (mst[s][e] > 0) {
-                total += mst[s][e];
-                count++;
-            }
-        }
+    Weight total = 0;
+    Weight count = 0;
+    for (const auto &[u, v, w] : treeEdges) {
+        total += w;
+        count++;
     }
 
     if (count == 0)
@@ -347,3 +597,116 @@ int MST::averageDist() {
 
     return (total + count) / count;
 }
+
+/**
+ * pairDistances
+ * Aggregates the tree distance of every pair of connected vertices in O(V), from the
+ * subtree sizes alone: the edge from v to its parent lies on the path of exactly the
+ * size(v) * (component size - size(v)) pairs with one end in the subtree of v, so the sum of
+ * all distances is the sum of w * size(v) * (component size - size(v)) over the edges.
+ * One pass over the vertices from the deepest up also merges, for each vertex, the count,
+ * sum, sum of squares and extremes of the distances down into its subtree, which gives the
+ * sum of the squared distances and the closest and farthest pair the same way. Sums are
+ * kept in DistanceSum, so weights near the 64-bit range do not wrap them.
+ *
+ * @return The stats, all 0 if no two vertices are connected.
+ */
+PairDistanceStats MST::pairDistances() const
+{
+    PairDistanceStats stats;
+    int n = vertexCount;
+
+    // Every vertex after its parent: the roots, then their children level by level
+    vector<int> order;
+    order.reserve(n);
+    for (int r = 0; r < n; r++)
+    {
+        if (parent[r] != -1)
+            continue;
+        order.push_back(r);
+        for (size_t head = order.size() - 1; head < order.size(); head++)
+        {
+            int u = order[head];
+            order.insert(order.end(), children.begin() + childStart[u], children.begin() + childStart[u + 1]);
+        }
+    }
+
+    // Distances from each vertex down into its subtree, itself included at 0
+    vector<long long> size(n, 1);
+    vector<Weight> nearest(n, 0);
+    vector<DistanceSum> down(n, 0), farthest(n, 0);
+    vector<long double> downSquares(n, 0);
+    long double squares = 0;
+    bool any = false;
+    for (int i = n - 1; i >= 0; i--)
+    {
+        int v = order[i], p = parent[v];
+        if (p == -1)
+            continue;
+        // The subtree of v seen from p: every distance one edge longer
+        Weight w = parentWeight[v];
+        DistanceSum sum = down[v] + DistanceSum(w) * size[v];
+        long double sumSquares = downSquares[v] + 2.0L * w * (long double)down[v] + (long double)w * w * size[v];
+        Weight near = nearest[v] + w;
+        DistanceSum far = farthest[v] + w;
+
+        // The pairs with one end in the subtree of v and the other in what p has merged so far
+        squares += size[p] * sumSquares + size[v] * downSquares[p] + 2.0L * (long double)down[p] * (long double)sum;
+        stats.min = any ? std::min(stats.min, nearest[p] + near) : nearest[p] + near;
+        stats.max = any ? std::max(stats.max, farthest[p] + far) : farthest[p] + far;
+        any = true;
+
+        size[p] += size[v];
+        down[p] += sum;
+        downSquares[p] += sumSquares;
+        nearest[p] = std::min(nearest[p], near);
+        farthest[p] = std::max(farthest[p], far);
+    }
+
+    // The edge contributions, with the size of the component each edge belongs to
+    vector<long long> component(n);
+    for (int v : order)
+        component[v] = parent[v] == -1 ? size[v] : component[parent[v]];
+    for (int v = 0; v < n; v++)
+    {
+        if (parent[v] != -1)
+            stats.sum += DistanceSum(parentWeight[v]) * size[v] * (component[v] - size[v]);
+        else
+            stats.pairs += size[v] * (size[v] - 1) / 2;
+    }
+
+    if (stats.pairs > 0)
+    {
+        stats.mean = (double)((long double)stats.sum / stats.pairs);
+        long double variance = squares / stats.pairs - (long double)stats.mean * stats.mean;
+        stats.stddev = variance > 0 ? (double)sqrtl(variance) : 0;
+    }
+    return stats;
+}
+
+// Formats a sum of distances, which is never negative; the streams do not print DistanceSum
+static string distanceText(DistanceSum value)
+{
+    string digits;
+    do
+    {
+        digits.push_back(char('0' + int(value % 10)));
+        value /= 10;
+    } while (value > 0);
+    return string(digits.rbegin(), digits.rend());
+}
+
+string PairDistanceStats::report() const
+{
+    if (pairs == 0)
+        return "All-pairs distances in MST: no two vertices are connected\n";
+    ostringstream out;
+    out << fixed << setprecision(3);
+    out << "All-pairs distances in MST: " << pairs << " pairs\n"
+        << "Sum: " << distanceText(sum) << "\n"
+        << "Mean: " << mean << "\n"
+        << "Standard deviation: " << stddev << "\n"
+        << "Min: " << min << "\n"
+        << "Max: " << distanceText(max) << "\n";
+    return out.str();
+}
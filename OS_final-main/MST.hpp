@@ -1,4 +1,7 @@
+#pragma once
 #include "Graph.hpp"
+#include "WorkStealingPool.hpp"
+#include "MatrixScan.hpp"
 #include <limits>
 #include <functional>
 #include <queue>
@@ -7,25 +10,81 @@
 #include <random>
 #include <ctime>
 #include <vector>
+#include <memory_resource>
+#include <tuple>
+#include <optional>
 using namespace std;
+
+// The MST algorithms; the protocol names them "kruskal" and "boruvka"
+enum class MstAlgorithm
+{
+    Kruskal,
+    Boruvka,
+};
+
+optional<MstAlgorithm> parseMstAlgorithm(const string &name); // nullopt for an unknown name
+
+// Distances summed over many pairs or along a long path, which 64-bit weights overflow:
+// V^3 times the largest weight still fits
+__extension__ typedef __int128 DistanceSum;
+
+// this is a struct that holds the distances in the tree between all pairs of vertices it connects
+struct PairDistanceStats
+{
+    long long pairs = 0; // Unordered pairs of distinct vertices in the same component
+    DistanceSum sum = 0; // Exact sum of their distances
+    double mean = 0;
+    double stddev = 0;
+    Weight min = 0;      // Closest pair: the lightest tree edge
+    DistanceSum max = 0; // Farthest pair: the weighted diameter of the tree
+    string report() const; // The stats, as the server's option shows them
+};
+
 class MST
 {
-    Graph graph;
-    vector<vector<int>> mst;
-    void kruskal(vector<vector<int>> &adj);
-    void boruvka(vector<vector<int>> &adj);
+    int vertexCount = 0;
+    vector<tuple<int, int, Weight>> treeEdges; // (u, v, w) with u < v, sorted
+
+    // The tree rooted at vertex 0; in a disconnected graph every other component is rooted
+    // at its lowest vertex
+    vector<int> parent;       // -1 for the roots
+    vector<Weight> parentWeight; // Weight of the edge to the parent
+    vector<int> depth;        // Edges between a vertex and its root
+    vector<int> childStart;   // Children of v are children[childStart[v] .. childStart[v + 1])
+    vector<int> children;
+
+    WorkStealingPool *pool; // Optional pool for the parallel parts of the algorithms
+    // Instantiated for each cell type of the graph's weight matrix (see Graph.hpp)
+    template <typename Cell>
+    void kruskal(const FlatMatrix<Cell> &adj, const BitMatrix &edgeBits, std::pmr::memory_resource *scratch);
+    template <typename Cell>
+    void boruvka(const FlatMatrix<Cell> &adj, const BitMatrix &edgeBits, bool symmetric, std::pmr::memory_resource *scratch);
+    void build(const Graph &graph, optional<MstAlgorithm> algorithm, std::pmr::memory_resource *scratch);
+    void buildTree();
+    vector<int> treePath(int s, int e) const;
+
+    MST() : pool(nullptr) {} // Filled in by MstFile::load
+    friend class MstFile;
  
 
 public:
-    MST(Graph graph, string type);
-    int getWieghtMst();
-    int averageDist();
+    // scratch holds the temporary working sets of the construction (edge lists, union-find arrays)
+    MST(const Graph &graph, MstAlgorithm algorithm, WorkStealingPool *pool = nullptr, std::pmr::memory_resource *scratch = std::pmr::get_default_resource());
+    // By protocol name; an unknown name prints "Invalid algorithm" and leaves the tree empty
+    MST(const Graph &graph, string type, WorkStealingPool *pool = nullptr, std::pmr::memory_resource *scratch = std::pmr::get_default_resource());
+    int getNumVertices() const { return vertexCount; }
+    Weight getWieghtMst();
+    Weight averageDist();
     vector<int> longestPath(int s, int e);
     vector<int> shortestPath(int s, int e);
-    vector<vector<int>> getMST();
-   
-
-    vector<int> reconstructPath(const vector<int> &parent_node, int start, int end);
-    void dfs(const vector<vector<pair<int, int>>> &adj, int node, int parent, vector<int> &distance, vector<int> &parent_node);
-    vector<vector<pair<int, int>>> buildAdjList(const vector<vector<int>> &mst);
+    FlatMatrix<Weight> getMST() const;        // Builds the V x V matrix form
+    void matrixRow(int u, Weight *row) const; // Fills one row of the matrix form, in O(V)
+    const vector<tuple<int, int, Weight>> &edgeList() const { return treeEdges; }
+    vector<int> parentArray(int root = 0) const;
+    // The tree path from s to e into path, reusing its capacity and that of scratch; returns its
+    // weight, or -1 with an empty path if the vertices are out of range or in different components
+    Weight treePathInto(int s, int e, vector<int> &path, vector<int> &scratch) const;
+    PairDistanceStats pairDistances() const; // Over all pairs in O(V), without a single path query
+    size_t treeBytes() const;  // Bytes of the tree edges
+    size_t indexBytes() const; // Bytes of the rooted tree the path queries walk
 };
\ No newline at end of file
@@ -1,6 +1,21 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest.h"
 #include "MST.hpp"
+#include "Serializer.hpp"
+#include "Arena.hpp"
+#include "GraphFile.hpp"
+#include "GraphRegistry.hpp"
+#include "GraphStore.hpp"
+#include "MemoryBudget.hpp"
+#include "MstFile.hpp"
+#include "PathBatch.hpp"
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <random>
+#include <sstream>
+#include <csignal>
+#include <sys/resource.h>
 
 class TestGraph
 {
@@ -129,9 +144,10 @@ public:
         return Graph(adj_matrix);
     }
 };
-bool isValidMST( Graph &original, const vector<vector<int>> &mst)
+bool isValidMST( Graph &original, const FlatMatrix<Weight> &mst)
 {
-    int n = original.getAdjMat().size();
+    FlatMatrix<Weight> adj = original.getAdjMat(); // Widened copy, taken once
+    int n = adj.size();
     vector<int> parent(n);
     for (int i = 0; i < n; i++)
         parent[i] = i;
@@ -150,7 +166,7 @@ bool isValidMST( Graph &original, const vector<vector<int>> &mst)
             parent[py] = px;
     };
 
-    int mstWeight = 0;
+    Weight mstWeight = 0;
     int edgeCount = 0;
     for (int i = 0; i < n; i++)
     {
@@ -159,7 +175,7 @@ bool isValidMST( Graph &original, const vector<vector<int>> &mst)
             if (mst[i][j] > 0)
             {
                 // Check if the edge exists in the original graph
-                if (original.getAdjMat()[i][j] != mst[i][j]){
+                if (adj[i][j] != mst[i][j]){
                     std::cout << "Edge doesn't exist in original graph" << std::endl;
                     return false;
                 }
@@ -190,9 +206,9 @@ bool isValidMST( Graph &original, const vector<vector<int>> &mst)
     {
         for (int j = i + 1; j < n; j++)
         {
-            if (original.getAdjMat()[i][j] > 0 && find(i) != find(j))
+            if (adj[i][j] > 0 && find(i) != find(j))
             {
-                if (original.getAdjMat()[i][j] < mst[i][j])
+                if (adj[i][j] < mst[i][j])
                 std::cout << "Not minimal" << std::endl;
                     return false;
             }
@@ -203,6 +219,28 @@ bool isValidMST( Graph &original, const vector<vector<int>> &mst)
 }
 
 
+TEST_CASE("Test flat matrix layout")
+{
+    vector<vector<int>> nested = {{0, 1, 2}, {3, 4, 5}};
+    Matrix matrix(nested);
+    CHECK(matrix.rows() == 2);
+    CHECK(matrix.cols() == 3);
+    CHECK(matrix.stride() == 16); // One 64-byte line per row
+    for (size_t i = 0; i < matrix.rows(); i++)
+    {
+        CHECK(reinterpret_cast<uintptr_t>(matrix[i]) % Matrix::ALIGNMENT == 0);
+        CHECK(matrix[i][matrix.cols()] == 0); // Padding is zeroed
+    }
+    CHECK(matrix.toVectors() == nested);
+
+    Matrix copy = matrix;
+    copy.at(1, 2) = 9;
+    CHECK(matrix[1][2] == 5);
+    CHECK_FALSE(copy == matrix);
+    CHECK_THROWS_AS(copy.at(2, 0), std::out_of_range);
+    CHECK_THROWS_AS(Matrix(vector<vector<int>>{{1, 2}, {3}}), std::invalid_argument);
+}
+
 TEST_CASE("Test MST on fully connected graph")
 {
     int n = 20;
@@ -270,3 +308,1039 @@ TEST_CASE("Test on graph with large integer weights")
     MST mst(graph, "kruskal");
     CHECK(isValidMST(graph, mst.getMST()));
 }
+
+TEST_CASE("Test parallel Boruvka with a work-stealing pool")
+{
+    WorkStealingPool pool(4);
+    Graph graph = comlexTestGraph::createLargeGraph(400, 1000);
+    MST serial(graph, "kruskal");
+    MST parallel(graph, "boruvka", &pool);
+
+    CHECK(parallel.getWieghtMst() == serial.getWieghtMst());
+}
+
+TEST_CASE("Test MST with scratch memory from a request arena")
+{
+    WorkStealingPool pool(4);
+    RequestArena arena;
+    Graph graph = comlexTestGraph::createLargeGraph(400, 1000);
+    MST expected(graph, "kruskal");
+    for (int round = 0; round < 2; round++) // The second round reuses the reset arena
+    {
+        MST kruskal(graph, "kruskal", nullptr, arena.resource());
+        MST boruvka(graph, "boruvka", &pool, arena.resource());
+        CHECK(kruskal.getMST() == expected.getMST());
+        CHECK(boruvka.getWieghtMst() == expected.getWieghtMst());
+        arena.reset();
+    }
+
+    // Boruvka's scratch does not grow with its rounds: a star joins in one round, the random
+    // graph takes several, and both take the same bytes
+    struct CountingResource : std::pmr::memory_resource
+    {
+        size_t bytes = 0;
+        void *do_allocate(size_t size, size_t align) override
+        {
+            bytes += size;
+            return std::pmr::new_delete_resource()->allocate(size, align);
+        }
+        void do_deallocate(void *p, size_t size, size_t align) override { std::pmr::new_delete_resource()->deallocate(p, size, align); }
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+    };
+    vector<vector<int>> star(400, vector<int>(400, 0));
+    for (int v = 1; v < 400; v++)
+        star[0][v] = star[v][0] = v;
+    CountingResource oneRound, manyRounds;
+    MST(Graph(star), "boruvka", &pool, &oneRound);
+    MST(graph, "boruvka", &pool, &manyRounds);
+    CHECK(oneRound.bytes == manyRounds.bytes);
+}
+
+TEST_CASE("Test work-stealing pool runs every task")
+{
+    WorkStealingPool pool(4);
+    std::atomic<int> counter{0};
+    pool.parallelFor(0, 1000, 7, [&](size_t lo, size_t hi)
+                     {
+        // Nested submissions go to the worker's own deque and get stolen by the others
+        pool.parallelFor(lo, hi, 1, [&](size_t a, size_t b) { counter += b - a; }); });
+    CHECK(counter == 1000);
+
+    // A chunk that throws on any thread ends the loop with its exception, not a hang
+    CHECK_THROWS_AS(pool.parallelFor(0, 64, 1, [&](size_t lo, size_t)
+                                     { if (lo == 37) throw std::runtime_error("chunk failed"); }),
+                    std::runtime_error);
+    pool.parallelFor(0, 64, 1, [&](size_t lo, size_t hi) { counter += hi - lo; });
+    CHECK(counter == 1064);
+}
+
+TEST_CASE("Test adaptive pool stays within the hardware threads")
+{
+    WorkStealingPool pool(1, true);
+    std::atomic<int> counter{0};
+    for (int i = 0; i < 100; i++)
+        pool.submit([&]() { counter++; });
+    pool.parallelFor(0, 100, 1, [&](size_t lo, size_t hi) { counter += hi - lo; });
+    while (counter < 200)
+        std::this_thread::yield();
+
+    CHECK(pool.size() >= 1);
+    CHECK(pool.size() <= std::max(std::thread::hardware_concurrency(), 1u));
+
+    // A pool pinned to one CPU, as each --reuseport shard's is, never outgrows its workers
+    WorkStealingPool pinned(2, true, 0);
+    for (int i = 0; i < 1000; i++)
+        pinned.submit([&]() { counter++; });
+    while (counter < 1200)
+        std::this_thread::yield();
+    CHECK(pinned.size() <= 2);
+}
+
+TEST_CASE("Test MST serializer matches stream formatting in small batches")
+{
+    Graph graph = comlexTestGraph::createLargeGraph(60, 1000000000);
+    MST mst(graph, "kruskal");
+    std::stringstream expected;
+    FlatMatrix<Weight> matrix = mst.getMST();
+    for (size_t i = 0; i < matrix.rows(); i++)
+    {
+        for (size_t j = 0; j < matrix.cols(); j++)
+            expected << matrix[i][j] << " ";
+        expected << "\n";
+    }
+
+    ChunkWriter out;
+    RowSerializer rows(mst.getNumVertices(), mst.getNumVertices(), [&](size_t u, Weight *row)
+                       { mst.matrixRow(u, row); });
+    std::string text;
+    int batches = 0;
+    bool more = true;
+    while (more)
+    {
+        more = rows.next(out, 100);
+        for (const auto &chunk : out.take())
+            text += chunk;
+        batches++;
+    }
+    CHECK(batches > 1);
+    CHECK(text == expected.str());
+}
+
+TEST_CASE("Test MST edge list and parent array")
+{
+    Graph graph = TestGraph::createSampleGraph();
+    for (const char *algo : {"kruskal", "boruvka"})
+    {
+        MST mst(graph, algo);
+        auto matrix = mst.getMST();
+        const auto &edges = mst.edgeList();
+        CHECK(edges.size() == 4);
+        int weight = 0;
+        for (const auto &[u, v, w] : edges)
+        {
+            CHECK(u < v);
+            CHECK(matrix[u][v] == w);
+            weight += w;
+        }
+        CHECK(weight == mst.getWieghtMst());
+
+        vector<int> parent = mst.parentArray(0);
+        CHECK(parent[0] == -1);
+        for (int v = 1; v < 5; v++)
+            CHECK(matrix[v][parent[v]] > 0);
+    }
+}
+
+TEST_CASE("Test MST tree paths on a disconnected graph")
+{
+    // Two components: the path 0-1-2-3 and the edge 4-5
+    vector<vector<int>> adj_matrix = {
+        {0, 1, 0, 0, 0, 0},
+        {1, 0, 2, 0, 0, 0},
+        {0, 2, 0, 3, 0, 0},
+        {0, 0, 3, 0, 0, 0},
+        {0, 0, 0, 0, 0, 4},
+        {0, 0, 0, 0, 4, 0}};
+    Graph graph(adj_matrix);
+    MST mst(graph, "boruvka");
+
+    CHECK(mst.shortestPath(3, 0) == vector<int>{3, 2, 1, 0});
+    CHECK(mst.longestPath(1, 3) == vector<int>{1, 2, 3});
+    CHECK(mst.shortestPath(0, 5).empty());
+    CHECK(mst.shortestPath(0, 6).empty());
+
+    CHECK(mst.parentArray(0) == vector<int>{-1, 0, 1, 2, -1, 4});
+    CHECK(mst.parentArray(2) == vector<int>{1, 2, -1, 2, -1, 4});
+
+    vector<Weight> row(6);
+    mst.matrixRow(2, row.data());
+    CHECK(row == vector<Weight>{0, 2, 0, 3, 0, 0});
+    CHECK(mst.getMST() == FlatMatrix<Weight>(Matrix(adj_matrix)));
+}
+
+// Compares the dispatched kernels with the scalar scans for one cell type
+template <typename Cell>
+void checkRowScans(int maxWeight)
+{
+    std::mt19937 gen(7);
+    for (int n : {0, 1, 7, 8, 15, 16, 17, 63, 100, 257})
+    {
+        for (int round = 0; round < 20; round++)
+        {
+            vector<Cell> row(n);
+            vector<int> comp(n);
+            for (int j = 0; j < n; j++)
+            {
+                // Many ties, and weights up to the top of the cell's range
+                row[j] = gen() % 4 == 0 ? 0 : gen() % 2 ? 1 + gen() % 5 : maxWeight - gen() % 3;
+                comp[j] = gen() % 3;
+            }
+            int own = gen() % 3;
+            CHECK(cheapestInRow(row.data(), comp.data(), own, n) == cheapestInRowScalar(row.data(), comp.data(), own, n));
+
+            int from = n == 0 ? 0 : gen() % n;
+            vector<int> cols(n + EDGE_COLUMNS_SLACK), expected(n + EDGE_COLUMNS_SLACK);
+            int count = edgeColumns(row.data(), from, n, cols.data());
+            CHECK(count == edgeColumnsScalar(row.data(), from, n, expected.data()));
+            CHECK(std::equal(cols.begin(), cols.begin() + count, expected.begin()));
+        }
+    }
+}
+
+TEST_CASE("Test vectorized row scans match the scalar scans")
+{
+    MESSAGE("Matrix scan kernel: " << std::string(matrixScanKernel()));
+    checkRowScans<uint8_t>(255);
+    checkRowScans<uint16_t>(65535);
+    checkRowScans<int>(1000000000);
+}
+
+TEST_CASE("Test narrow weight storage")
+{
+    auto twoVertices = [](int weight)
+    { return Graph(vector<vector<int>>{{0, weight}, {1, 0}}); };
+    CHECK(twoVertices(255).cellSize() == 1);
+    CHECK(twoVertices(256).cellSize() == 2);
+    CHECK(twoVertices(65535).cellSize() == 2);
+    CHECK(twoVertices(65536).cellSize() == 4);
+    CHECK(twoVertices(-1).cellSize() == 4);
+    CHECK(twoVertices(256).weight(0, 1) == 256);
+
+    Graph graph = comlexTestGraph::createLargeGraph(300, 200);
+    FlatMatrix<Weight> widened = graph.getAdjMat();
+    MST narrow(graph, "kruskal");
+    CHECK(MST(graph, "boruvka").edgeList() == narrow.edgeList());
+
+    // The same weights in int cells give the same tree
+    widened[0][1] = widened[1][0] = 0;
+    widened[0][2] = widened[2][0] = 100000;
+    Graph wide(widened);
+    CHECK(wide.cellSize() == 4);
+    graph.removeEdge(0, 1);
+    graph.removeEdge(1, 0);
+    graph.addEdge(0, 2, 100000); // Widens the one-byte cells
+    graph.addEdge(2, 0, 100000);
+    CHECK(graph.cellSize() == 4);
+    CHECK(graph.isSymmetric());
+    CHECK(graph.getAdjMat() == widened);
+    CHECK(MST(graph, "kruskal").edgeList() == MST(wide, "kruskal").edgeList());
+    CHECK(MST(graph, "boruvka").edgeList() == MST(wide, "boruvka").edgeList());
+
+    graph.addEdge(0, 3, 300); // Already wide enough, stays int
+    CHECK(graph.cellSize() == 4);
+    CHECK(graph.weight(0, 3) == 300);
+}
+
+TEST_CASE("Test Boruvka matches Kruskal on symmetric and asymmetric graphs")
+{
+    WorkStealingPool pool(4);
+    Graph graph = comlexTestGraph::createLargeGraph(300, 20); // Small weights, many ties
+    CHECK(graph.isSymmetric());
+    MST kruskal(graph, "kruskal");
+    CHECK(MST(graph, "boruvka").edgeList() == kruskal.edgeList());
+    CHECK(MST(graph, "boruvka", &pool).edgeList() == kruskal.edgeList());
+    CHECK(MST(graph, "kruskal", &pool).edgeList() == kruskal.edgeList());
+
+    graph.addEdge(0, 299, 1); // One direction only
+    CHECK_FALSE(graph.isSymmetric());
+    CHECK(isValidMST(graph, MST(graph, "boruvka").getMST()));
+    graph.addEdge(299, 0, 1);
+    CHECK(graph.isSymmetric());
+}
+
+TEST_CASE("Test 64-bit weights and sums")
+{
+    auto twoVertices = [](Weight weight)
+    { return Graph(FlatMatrix<Weight>(vector<vector<Weight>>{{0, weight}, {1, 0}})); };
+    CHECK(twoVertices(100000).cellSize() == 4); // int cells
+    CHECK(twoVertices(3000000000).cellSize() == 4); // uint32_t cells
+    CHECK(twoVertices(5000000000).cellSize() == 8);
+    CHECK(twoVertices(-5).cellSize() == 4);
+    CHECK(twoVertices(3000000000).weight(0, 1) == 3000000000);
+
+    // Weights near 2^32: the total of a 50-vertex tree is far beyond int
+    int n = 50;
+    std::mt19937 gen(5);
+    FlatMatrix<Weight> adj(n, n);
+    Weight expected = 0;
+    for (int i = 1; i < n; i++)
+    {
+        Weight weight = 4000000000 + gen() % 1000;
+        adj[i][i - 1] = adj[i - 1][i] = weight; // A path, so the MST is the whole graph
+        expected += weight;
+    }
+    Graph graph(adj);
+    CHECK(graph.cellSize() == 4);
+    MST kruskal(graph, "kruskal");
+    CHECK(kruskal.getWieghtMst() == expected);
+    CHECK(MST(graph, "boruvka").edgeList() == kruskal.edgeList());
+    CHECK(isValidMST(graph, kruskal.getMST()));
+
+    graph.addEdge(0, 2, -1); // uint32_t and int cells together need int64_t ones
+    CHECK(graph.cellSize() == 8);
+    CHECK(graph.weight(1, 2) == adj[1][2]);
+    CHECK(MST(graph, "kruskal").getWieghtMst() == expected);
+
+    ChunkWriter out;
+    out.append(std::numeric_limits<int64_t>::min());
+    out.append(' ');
+    out.append(kruskal.getWieghtMst());
+    std::string text;
+    for (auto &part : out.take())
+        text += part;
+    CHECK(text == "-9223372036854775808 " + std::to_string(expected));
+}
+
+TEST_CASE("Test MST engines by algorithm and by protocol name")
+{
+    CHECK(parseMstAlgorithm("kruskal") == MstAlgorithm::Kruskal);
+    CHECK(parseMstAlgorithm("boruvka") == MstAlgorithm::Boruvka);
+    CHECK_FALSE(parseMstAlgorithm("prim").has_value());
+
+    Graph graph = comlexTestGraph::createLargeGraph(120, 50);
+    MST byName(graph, "kruskal");
+    CHECK(MST(graph, MstAlgorithm::Kruskal).edgeList() == byName.edgeList());
+    CHECK(MST(graph, MstAlgorithm::Boruvka).edgeList() == byName.edgeList());
+    CHECK(isValidMST(graph, MST(graph, MstAlgorithm::Boruvka).getMST()));
+}
+
+TEST_CASE("Test edge bitset")
+{
+    BitMatrix bits(3, 130);
+    for (size_t col : {0, 63, 64, 65, 127, 129})
+        bits.set(1, col, true);
+    bits.set(1, 65, false);
+    CHECK(bits.test(1, 64));
+    CHECK_FALSE(bits.test(1, 65));
+    CHECK(bits.count(1, 0, 130) == 5);
+    CHECK(bits.count(1, 1, 129) == 3);
+    CHECK(bits.count(0, 0, 130) == 0);
+    vector<size_t> cols;
+    bits.forEach(1, 63, 128, [&](size_t col)
+                 { cols.push_back(col); });
+    CHECK(cols == vector<size_t>{63, 64, 127});
+
+    Graph graph(vector<vector<int>>{{0, 5, -1}, {5, 0, 0}, {0, 0, 0}});
+    CHECK(graph.getEdgeBits().test(0, 1));
+    CHECK_FALSE(graph.getEdgeBits().test(0, 2)); // Negative weights are not taken as edges
+    graph.addEdge(2, 1, 7);
+    CHECK(graph.getEdgeBits().test(2, 1));
+    graph.removeEdge(0, 1);
+    CHECK_FALSE(graph.getEdgeBits().test(0, 1));
+}
+
+TEST_CASE("Test MST on sparse rows walked through the edge bitset")
+{
+    int n = 400;
+    std::mt19937 gen(11);
+    Matrix adj(n, n);
+    for (int i = 1; i < n; i++)
+    {
+        int j = gen() % i; // A random spanning tree, then a few extra edges
+        adj[i][j] = adj[j][i] = 1 + gen() % 1000;
+    }
+    for (int k = 0; k < n; k++)
+    {
+        int i = gen() % n, j = gen() % n;
+        if (i != j)
+            adj[i][j] = adj[j][i] = 1 + gen() % 1000;
+    }
+    Graph graph(adj);
+    MST kruskal(graph, "kruskal");
+    CHECK(isValidMST(graph, kruskal.getMST()));
+    CHECK(MST(graph, "boruvka").edgeList() == kruskal.edgeList());
+
+    graph.addEdge(0, n - 1, 1); // One direction only, scanned through the bitset as well
+    CHECK_FALSE(graph.isSymmetric());
+    CHECK(isValidMST(graph, MST(graph, "boruvka").getMST()));
+}
+
+TEST_CASE("Test chunked framing of a streamed result")
+{
+    ChunkWriter out;
+    out.setChunked(true);
+    out.append("Path: ");
+    ArraySerializer values({1, 22, 333});
+    std::string wire;
+    while (values.next(out, 4))
+    {
+        for (const auto &part : out.take())
+            wire += part;
+    }
+    out.finish();
+    for (const auto &part : out.take())
+        wire += part;
+    CHECK(wire == "6\r\nPath: \r\n5\r\n1 22 \r\n5\r\n333 \n\r\n0\r\n\r\n");
+}
+
+TEST_CASE("Test graph file round trip and corruption checks")
+{
+    std::string path = (std::filesystem::temp_directory_path() / ("mst_test_graph_" + std::to_string(getpid()))).string();
+    auto sameGraph = [](Graph a, Graph b)
+    {
+        return a.getNumVertices() == b.getNumVertices() && a.cellSize() == b.cellSize() &&
+               a.getAdjMat() == b.getAdjMat() && a.isSymmetric() == b.isSymmetric();
+    };
+
+    SUBCASE("Every cell type comes back as it was saved")
+    {
+        Graph narrow = TestGraph::createSampleGraph(); // uint8_t cells
+        Graph medium(vector<vector<int>>{{0, 70000, -3}, {70000, 0, 0}, {-3, 0, 0}}); // int cells
+        FlatMatrix<Weight> wide(3, 3);
+        wide[0][1] = wide[1][0] = 8000000000;
+        wide[1][2] = 1; // One direction only
+        Graph widest(std::move(wide)); // int64_t cells
+        for (Graph *graph : {&narrow, &medium, &widest})
+        {
+            saveGraphFile(*graph, path);
+            Graph loaded = loadGraphFile(path);
+            CHECK(sameGraph(loaded, *graph));
+            CHECK(MST(loaded, "kruskal").edgeList() == MST(*graph, "kruskal").edgeList());
+        }
+        saveGraphFile(Graph{Matrix()}, path);
+        CHECK(loadGraphFile(path).getNumVertices() == 0);
+    }
+
+    SUBCASE("Damaged files are rejected")
+    {
+        saveGraphFile(TestGraph::createSampleGraph(), path);
+        std::string bytes;
+        {
+            std::ifstream in(path, std::ios::binary);
+            bytes.assign(std::istreambuf_iterator<char>(in), {});
+        }
+        auto writeBytes = [&](const std::string &data)
+        {
+            std::ofstream(path, std::ios::binary | std::ios::trunc) << data;
+        };
+
+        std::string flipped = bytes;
+        flipped.back() ^= 1; // Last weight
+        writeBytes(flipped);
+        CHECK_THROWS_AS(loadGraphFile(path), std::runtime_error);
+
+        writeBytes(bytes.substr(0, bytes.size() - 1));
+        CHECK_THROWS_AS(loadGraphFile(path), std::runtime_error);
+
+        flipped = bytes;
+        flipped[offsetof(GraphFileHeader, vertices)] ^= 1;
+        writeBytes(flipped);
+        CHECK_THROWS_AS(loadGraphFile(path), std::runtime_error);
+
+        writeBytes("not a graph file at all, just some text that is long enough to hold a header");
+        CHECK_THROWS_AS(loadGraphFile(path), std::runtime_error);
+
+        writeBytes(bytes);
+        CHECK(sameGraph(loadGraphFile(path), TestGraph::createSampleGraph()));
+    }
+
+    std::filesystem::remove(path);
+    CHECK_THROWS_AS(loadGraphFile(path), std::runtime_error);
+    CHECK(preloadGraphFile(path).getNumVertices() == 0); // No file yet: start empty
+}
+
+TEST_CASE("Test mutation log replay, torn tails and checkpoints")
+{
+    std::string path = (std::filesystem::temp_directory_path() / ("mst_test_store_" + std::to_string(getpid()))).string();
+    std::filesystem::remove(path);
+    std::filesystem::remove(path + ".log");
+    Graph expected = TestGraph::createSampleGraph();
+    std::vector<Mutation> mutations = {{Mutation::AddEdge, 0, 2, 4}, {Mutation::AddEdge, 2, 0, 4}, {Mutation::RemoveEdge, 1, 3}, {Mutation::RemoveEdge, 3, 1}, {Mutation::AddEdge, 4, 0, 300}};
+
+    {
+        GraphStore store(path);
+        CHECK(store.load().getNumVertices() == 0);
+        Graph graph = TestGraph::createSampleGraph();
+        store.checkpoint(graph);
+
+        // Appends from several threads are all made durable, in as few batches as happen to form.
+        // The mutations touch different cells, so the order the threads log them in does not matter.
+        std::atomic<int> durable{0};
+        std::promise<void> allDurable;
+        std::vector<std::thread> threads;
+        for (const Mutation &mutation : mutations)
+        {
+            GraphStore::apply(expected, mutation);
+            threads.emplace_back([&, mutation]()
+                                 { store.append(mutation, [&](bool ok)
+                                                { if (ok && ++durable == (int)mutations.size()) allDurable.set_value(); }); });
+        }
+        for (auto &thread : threads)
+            thread.join();
+        allDurable.get_future().wait();
+        CHECK(durable == (int)mutations.size());
+        CHECK_FALSE(store.needsCheckpoint());
+    }
+
+    // A record torn by a crash is cut off, and the records before it are replayed
+    {
+        std::ofstream(path + ".log", std::ios::binary | std::ios::app) << "torn record";
+        GraphStore store(path);
+        size_t replayed;
+        Graph graph = store.load(&replayed);
+        CHECK(replayed == mutations.size());
+        CHECK(graph.getAdjMat() == expected.getAdjMat());
+        CHECK(graph.cellSize() == 2); // Widened by the weight 300 on replay
+        CHECK(std::filesystem::file_size(path + ".log") == sizeof(MutationLogHeader) + mutations.size() * sizeof(MutationRecord));
+        store.checkpoint(graph);
+    }
+
+    // After a checkpoint the snapshot holds everything and the log is empty
+    {
+        GraphStore store(path);
+        size_t replayed;
+        CHECK(store.load(&replayed).getAdjMat() == expected.getAdjMat());
+        CHECK(replayed == 0);
+        std::promise<void> logged;
+        Mutation mutation{Mutation::AddEdge, 0, 1, 9};
+        GraphStore::apply(expected, mutation);
+        store.append(mutation, [&](bool)
+                     { logged.set_value(); });
+        logged.get_future().wait();
+    }
+
+    // A crash between saving a snapshot and emptying the log leaves a log of the old snapshot:
+    // it is discarded, since the new snapshot already holds its changes
+    saveGraphFile(expected, path);
+    {
+        GraphStore store(path);
+        size_t replayed;
+        CHECK(store.load(&replayed).getAdjMat() == expected.getAdjMat());
+        CHECK(replayed == 0);
+    }
+
+    // Records appended while a checkpoint writes its copy wait for it, then start the new log
+    {
+        GraphStore store(path);
+        Graph graph = store.load();
+        GraphStore::CheckpointTicket ticket = store.beginCheckpoint();
+        Graph copy = graph;
+        Mutation mutation{Mutation::AddEdge, 1, 2, 6};
+        GraphStore::apply(expected, mutation);
+        std::promise<bool> logged;
+        store.append(mutation, [&](bool ok)
+                     { logged.set_value(ok); });
+        store.checkpoint(copy, ticket);
+        CHECK(logged.get_future().get());
+    }
+    {
+        GraphStore store(path);
+        size_t replayed;
+        CHECK(store.load(&replayed).getAdjMat() == expected.getAdjMat());
+        CHECK(replayed == 1);
+    }
+
+    // After a lost batch the log has a hole: later records are refused until a checkpoint
+    {
+        GraphStore store(path);
+        Graph graph = store.load();
+        auto append = [&](Mutation mutation)
+        {
+            GraphStore::apply(graph, mutation);
+            std::promise<bool> logged;
+            store.append(mutation, [&](bool ok)
+                         { logged.set_value(ok); });
+            return logged.get_future().get();
+        };
+        rlimit limit;
+        getrlimit(RLIMIT_FSIZE, &limit);
+        rlimit full = limit;
+        full.rlim_cur = std::filesystem::file_size(path + ".log"); // The next write fails with EFBIG
+        auto previous = std::signal(SIGXFSZ, SIG_IGN);
+        setrlimit(RLIMIT_FSIZE, &full);
+        CHECK_FALSE(append({Mutation::AddEdge, 0, 3, 5}));
+        setrlimit(RLIMIT_FSIZE, &limit);
+        std::signal(SIGXFSZ, previous);
+
+        CHECK_FALSE(append({Mutation::AddEdge, 0, 4, 5}));
+        CHECK(store.needsCheckpoint());
+        store.checkpoint(graph);
+        CHECK_FALSE(store.needsCheckpoint());
+        CHECK(append({Mutation::RemoveEdge, 0, 4}));
+        expected = graph;
+    }
+    {
+        GraphStore store(path);
+        size_t replayed;
+        CHECK(store.load(&replayed).getAdjMat() == expected.getAdjMat());
+        CHECK(replayed == 1);
+    }
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(path + ".log");
+}
+
+TEST_CASE("Test MST files keyed by graph version")
+{
+    std::string path = (std::filesystem::temp_directory_path() / ("mst_test_tree_" + std::to_string(getpid()))).string();
+    int n = 300;
+    std::mt19937 gen(5);
+    Matrix adj(n, n);
+    for (int i = 1; i < n; i++)
+    {
+        int j = gen() % i;
+        adj[i][j] = adj[j][i] = 1 + gen() % 1000;
+    }
+    Graph graph(adj);
+    MST built(graph, MstAlgorithm::Boruvka);
+    GraphVersion version{42, 7};
+
+    MstFile::save(built, MstAlgorithm::Boruvka, version, path);
+    auto loaded = MstFile::load(MstAlgorithm::Boruvka, version, path);
+    REQUIRE(loaded);
+    CHECK(loaded->edgeList() == built.edgeList());
+    CHECK(loaded->parentArray(0) == built.parentArray(0));
+    CHECK(loaded->parentArray(17) == built.parentArray(17));
+    CHECK(loaded->getMST() == built.getMST());
+    CHECK(loaded->getWieghtMst() == built.getWieghtMst());
+    CHECK(loaded->shortestPath(3, n - 1) == built.shortestPath(3, n - 1));
+
+    CHECK_FALSE(MstFile::load(MstAlgorithm::Kruskal, version, path));
+    CHECK_FALSE(MstFile::load(MstAlgorithm::Boruvka, GraphVersion{42, 8}, path));
+
+    // Saves of the same path at once do not write into each other's temporary file
+    {
+        std::vector<std::thread> savers;
+        std::atomic<int> failures{0};
+        for (int i = 0; i < 8; i++)
+            savers.emplace_back([&]()
+                                {
+                for (int round = 0; round < 10; round++)
+                {
+                    try
+                    {
+                        MstFile::save(built, MstAlgorithm::Boruvka, version, path);
+                    }
+                    catch (const std::runtime_error &)
+                    {
+                        failures++;
+                    }
+                } });
+        for (auto &saver : savers)
+            saver.join();
+        CHECK(failures == 0);
+        REQUIRE(MstFile::load(MstAlgorithm::Boruvka, version, path));
+        auto directory = std::filesystem::path(path).parent_path();
+        std::string prefix = std::filesystem::path(path).filename().string() + ".";
+        for (const auto &entry : std::filesystem::directory_iterator(directory))
+            CHECK(entry.path().filename().string().rfind(prefix, 0) == std::string::npos); // No temporary file left
+    }
+    CHECK_FALSE(MstFile::rekey(GraphVersion{42, 8}, GraphVersion{43, 0}, path));
+    CHECK(MstFile::rekey(version, GraphVersion{43, 0}, path));
+    CHECK_FALSE(MstFile::load(MstAlgorithm::Boruvka, version, path));
+    CHECK(MstFile::load(MstAlgorithm::Boruvka, GraphVersion{43, 0}, path));
+
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(-1, std::ios::end);
+        file.put('\x7f'); // Into the children section
+    }
+    CHECK_FALSE(MstFile::load(MstAlgorithm::Boruvka, GraphVersion{43, 0}, path));
+    std::filesystem::remove(path);
+    CHECK_FALSE(MstFile::load(MstAlgorithm::Boruvka, GraphVersion{43, 0}, path));
+
+    SUBCASE("A graph store saves MSTs of durable versions and carries them over checkpoints")
+    {
+        std::filesystem::remove(path + ".log");
+        GraphStore store(path);
+        store.load();
+        store.checkpoint(graph);
+        GraphVersion current = store.version();
+        store.saveMst(built, MstAlgorithm::Kruskal, current);
+        REQUIRE(store.loadMst(MstAlgorithm::Kruskal, current));
+
+        std::promise<void> logged;
+        Mutation mutation{Mutation::AddEdge, 0, n - 1, 1};
+        GraphStore::apply(graph, mutation);
+        store.append(mutation, [&](bool)
+                     { logged.set_value(); });
+        GraphVersion next = store.version();
+        CHECK(next.mutations == current.mutations + 1);
+        CHECK_FALSE(store.loadMst(MstAlgorithm::Kruskal, next));
+        logged.get_future().wait();
+
+        MST rebuilt(graph, MstAlgorithm::Kruskal);
+        store.saveMst(rebuilt, MstAlgorithm::Kruskal, next);
+        store.checkpoint(graph);
+        auto carried = store.loadMst(MstAlgorithm::Kruskal, store.version());
+        REQUIRE(carried);
+        CHECK(carried->edgeList() == rebuilt.edgeList());
+
+        std::filesystem::remove(path);
+        std::filesystem::remove(path + ".log");
+        std::filesystem::remove(path + ".kruskal.mst");
+    }
+}
+
+TEST_CASE("Test graph registry create, select and drop")
+{
+    std::string path = (std::filesystem::temp_directory_path() / ("mst_test_registry_" + std::to_string(getpid()))).string();
+    GraphStore::removeFiles(path);
+    GraphStore::removeFiles(path + "@roads");
+    GraphStore::removeFiles(path + "@pipes");
+
+    {
+        GraphRegistry memory;
+        CHECK(memory.names() == std::vector<std::string>{GraphRegistry::DEFAULT_GRAPH});
+        auto roads = memory.create("roads");
+        CHECK_FALSE(roads->store);
+        CHECK(memory.find("roads") == roads);
+        CHECK_FALSE(memory.find("pipes"));
+        CHECK_THROWS_AS(memory.create("roads"), std::invalid_argument);
+        CHECK_THROWS_AS(memory.create("no spaces"), std::invalid_argument);
+        CHECK_THROWS_AS(memory.create(""), std::invalid_argument);
+        CHECK_THROWS_AS(memory.drop(GraphRegistry::DEFAULT_GRAPH), std::invalid_argument);
+        CHECK_THROWS_AS(memory.drop("pipes"), std::invalid_argument);
+
+        // Each graph is its own: a session bound to a dropped graph still holds it
+        roads->graph = TestGraph::createSampleGraph();
+        CHECK(memory.find(GraphRegistry::DEFAULT_GRAPH)->graph.getNumVertices() == 0);
+        memory.drop("roads");
+        CHECK_FALSE(memory.find("roads"));
+        CHECK(roads->graph.getNumVertices() == 5);
+    }
+
+    Graph sample = TestGraph::createSampleGraph();
+    {
+        GraphRegistry registry(path);
+        CHECK(registry.load().size() == 1);
+        for (const char *name : {"roads", "pipes"})
+        {
+            auto state = registry.create(name);
+            REQUIRE(state->store);
+            state->graph = sample;
+            state->store->checkpoint(state->graph);
+        }
+        auto pipes = registry.find("pipes");
+        std::promise<void> logged;
+        Mutation mutation{Mutation::AddEdge, 0, 4, 8};
+        GraphStore::apply(pipes->graph, mutation);
+        pipes->store->append(mutation, [&](bool)
+                             { logged.set_value(); });
+        logged.get_future().wait();
+        registry.drop("roads");
+        CHECK_FALSE(std::filesystem::exists(path + "@roads"));
+        CHECK_FALSE(std::filesystem::exists(path + "@roads.log"));
+        registry.find(GraphRegistry::DEFAULT_GRAPH)->graph = sample;
+        registry.checkpointAll();
+    }
+
+    // On restart the graphs saved next to the file come back, the dropped one does not
+    {
+        GraphRegistry registry(path);
+        auto loaded = registry.load();
+        CHECK(loaded.size() == 2);
+        CHECK(registry.names() == std::vector<std::string>{GraphRegistry::DEFAULT_GRAPH, "pipes"});
+        CHECK(registry.find(GraphRegistry::DEFAULT_GRAPH)->graph.getAdjMat() == sample.getAdjMat());
+        Graph expected = sample;
+        expected.addEdge(0, 4, 8);
+        CHECK(registry.find("pipes")->graph.getAdjMat() == expected.getAdjMat());
+
+        // A graph created under the name of an old one starts empty
+        registry.drop("pipes");
+        CHECK(registry.create("pipes")->graph.getNumVertices() == 0);
+    }
+
+    GraphStore::removeFiles(path);
+    GraphStore::removeFiles(path + "@pipes");
+}
+
+TEST_CASE("Test memory budget evicts cold entries in clock order")
+{
+    MemoryBudget budget(1000);
+    std::mutex lock;
+    std::map<int, MemoryBudget::Charge> entries;
+    auto add = [&](int id, MemoryKind kind, MemoryUse use, bool evictable)
+    {
+        std::function<bool()> evict;
+        if (evictable)
+            evict = [&, id]()
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                return entries.erase(id) == 1;
+            };
+        auto charge = budget.charge(kind, use, evict);
+        std::lock_guard<std::mutex> guard(lock);
+        entries.emplace(id, std::move(charge));
+    };
+    auto has = [&](int id)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return entries.count(id) == 1;
+    };
+
+    add(1, MemoryKind::Mst, {300, 100}, true);
+    add(2, MemoryKind::Graph, {400, 0}, false); // Never evicted
+    add(3, MemoryKind::Mst, {200, 0}, true);
+    CHECK(budget.stats().used == 1000);
+
+    // Every entry starts referenced: the hand clears them all, then evicts the first one it meets again
+    add(4, MemoryKind::Mst, {300, 0}, true);
+    budget.enforce();
+    CHECK_FALSE(has(1));
+    CHECK(budget.stats().used == 900);
+
+    // A touched entry gets a second chance
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        entries[3].touch();
+    }
+    add(5, MemoryKind::Mst, {300, 0}, true);
+    budget.enforce();
+    CHECK(has(2));
+    CHECK(has(3));
+    CHECK_FALSE(has(4));
+
+    budget.hit(MemoryKind::Mst);
+    budget.miss(MemoryKind::Mst);
+    MemoryStats stats = budget.stats();
+    CHECK(stats.used == 900);
+    CHECK(stats.kinds[int(MemoryKind::Mst)].entries == 2);
+    CHECK(stats.kinds[int(MemoryKind::Mst)].evictions == 2);
+    CHECK(stats.kinds[int(MemoryKind::Mst)].hits == 1);
+    CHECK(stats.kinds[int(MemoryKind::Graph)].dataBytes == 400);
+    CHECK(budget.report().find("2 evictions") != std::string::npos);
+
+    // Entries that cannot be evicted leave the charges over budget, and the sweep ends
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        entries[2].resize({2000, 0});
+    }
+    budget.enforce();
+    CHECK(has(2));
+    CHECK(budget.stats().used == 2000);
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        entries.clear();
+    }
+    CHECK(budget.stats().used == 0);
+
+    SUBCASE("Graphs no session is bound to are saved, unloaded and loaded again")
+    {
+        std::string path = (std::filesystem::temp_directory_path() / ("mst_test_budget_" + std::to_string(getpid()))).string();
+        GraphStore::removeFiles(path);
+        GraphStore::removeFiles(path + "@idle");
+        MemoryBudget tight(1);
+        {
+            GraphRegistry registry(path, &tight);
+            registry.load();
+            {
+                auto idle = registry.create("idle");
+                idle->graph = TestGraph::createSampleGraph();
+                idle->recharge();
+                tight.enforce(); // Bound to this session: it stays
+                CHECK(tight.stats().kinds[int(MemoryKind::Graph)].entries == 2);
+            }
+            tight.enforce();
+            CHECK(tight.stats().kinds[int(MemoryKind::Graph)].entries == 1);
+            CHECK(tight.stats().kinds[int(MemoryKind::Graph)].evictions == 1);
+            CHECK(registry.names() == std::vector<std::string>{GraphRegistry::DEFAULT_GRAPH, "idle"});
+
+            auto reloaded = registry.find("idle");
+            REQUIRE(reloaded);
+            CHECK(reloaded->graph.getAdjMat() == TestGraph::createSampleGraph().getAdjMat());
+            CHECK(tight.stats().kinds[int(MemoryKind::Graph)].misses == 1);
+            reloaded.reset();
+            tight.enforce();
+
+            // Finds that meet a load under way wait for it and share the one graph it loads
+            std::vector<std::shared_ptr<GraphState>> found(4);
+            std::vector<std::thread> finders;
+            for (auto &state : found)
+                finders.emplace_back([&]()
+                                     { state = registry.find("idle"); });
+            for (auto &finder : finders)
+                finder.join();
+            for (const auto &state : found)
+                CHECK(state == found[0]);
+            CHECK(tight.stats().kinds[int(MemoryKind::Graph)].misses == 2);
+            found.clear();
+            tight.enforce();
+            registry.drop("idle"); // Evicted again: only its files are deleted
+            CHECK_FALSE(std::filesystem::exists(path + "@idle.log"));
+        }
+        GraphStore::removeFiles(path);
+    }
+
+    SUBCASE("Cached MSTs are dropped from their graph's cache, but only for their version")
+    {
+        MemoryBudget tight(1);
+        auto state = std::make_shared<GraphState>();
+        state->graph = TestGraph::createSampleGraph();
+        auto mst = std::make_shared<MST>(state->graph, MstAlgorithm::Kruskal);
+        auto cache = [&](unsigned long version)
+        {
+            state->mstCache.insert_or_assign(MstAlgorithm::Kruskal, CachedMst{version, mst,
+                                                                              tight.charge(MemoryKind::Mst, {mst->treeBytes(), mst->indexBytes()},
+                                                                                           evictCachedMst(state, MstAlgorithm::Kruskal, version))});
+        };
+
+        cache(0);
+        state->version = 1; // A mutation moved on, but has not rebuilt the MST yet
+        CHECK_FALSE(evictCachedMst(state, MstAlgorithm::Kruskal, 1)());
+        tight.enforce();
+        CHECK(state->mstCache.empty());
+        CHECK(tight.stats().kinds[int(MemoryKind::Mst)].evictions == 1);
+
+        cache(1);
+        CHECK_FALSE(evictCachedMst(state, MstAlgorithm::Kruskal, 0)());
+        CHECK(state->mstCache.count(MstAlgorithm::Kruskal) == 1);
+        std::weak_ptr<GraphState> gone = std::make_shared<GraphState>();
+        CHECK_FALSE(evictCachedMst(gone, MstAlgorithm::Kruskal, 0)());
+        state->mstCache.clear();
+        CHECK(tight.stats().used == 0);
+    }
+}
+
+TEST_CASE("Test batch path queries match single queries")
+{
+    // Pairs cut anywhere by the reads they arrive in
+    PairReader reader(3);
+    CHECK(reader.feed("0 1"));
+    CHECK(reader.feed("2 3\n1"));
+    CHECK_FALSE(reader.complete());
+    CHECK(reader.feed("4 7 0\n"));
+    REQUIRE(reader.complete());
+    auto pairs = reader.take();
+    CHECK(pairs == vector<pair<int, int>>{{0, 12}, {3, 14}, {7, 0}});
+    CHECK_FALSE(PairReader(1).feed("1 x\n"));
+    CHECK(firstInvalidPair({{0, 1}, {1, 5}, {-1, 0}}, 5) == 1);
+
+    // A forest of two random trees, so some pairs have no path
+    const int n = 300;
+    std::mt19937 rng(7);
+    vector<vector<int>> adj_matrix(n, vector<int>(n, 0));
+    for (int v = 1; v < n; v++)
+    {
+        if (v == n / 2)
+            continue;
+        int u = v < n / 2 ? rng() % v : n / 2 + rng() % (v - n / 2);
+        adj_matrix[u][v] = adj_matrix[v][u] = 1 + rng() % 50;
+    }
+    auto mst = std::make_shared<MST>(Graph(adj_matrix), "boruvka");
+    vector<pair<int, int>> queries;
+    for (int i = 0; i < 5000; i++)
+        queries.emplace_back(rng() % n, rng() % n);
+
+    std::string expected;
+    for (auto [s, e] : queries)
+    {
+        vector<int> path = mst->shortestPath(s, e);
+        Weight weight = path.empty() ? -1 : 0;
+        for (size_t i = 1; i < path.size(); i++)
+            weight += adj_matrix[path[i - 1]][path[i]];
+        expected += std::to_string(s) + " " + std::to_string(e) + " " + std::to_string(weight) + ":";
+        for (int v : path)
+            expected += " " + std::to_string(v);
+        expected += "\n";
+    }
+
+    WorkStealingPool pool(4);
+    for (WorkStealingPool *on : {static_cast<WorkStealingPool *>(nullptr), &pool})
+    {
+        PathBatch batch(mst, queries, on);
+        ChunkWriter out;
+        std::string text;
+        int batches = 0;
+        bool more = true;
+        while (more)
+        {
+            more = batch.next(out, 4096);
+            for (auto &part : out.take())
+                text += part;
+            batches++;
+        }
+        CHECK(batch.done());
+        CHECK(batches > 1);
+        CHECK(text == expected);
+    }
+}
+
+TEST_CASE("Test all-pairs distance stats match summing every path")
+{
+    // The path 0 -1- 1 -2- 2: distances 1, 2 and 3
+    vector<vector<int>> path_matrix = {
+        {0, 1, 0},
+        {1, 0, 2},
+        {0, 2, 0}};
+    PairDistanceStats small = MST(Graph(path_matrix), "kruskal").pairDistances();
+    CHECK(small.pairs == 3);
+    CHECK(small.sum == 6);
+    CHECK(small.mean == doctest::Approx(2.0));
+    CHECK(small.stddev == doctest::Approx(std::sqrt(2.0 / 3)));
+    CHECK(small.min == 1);
+    CHECK(small.max == 3);
+    CHECK(MST(Graph(vector<vector<int>>{{0}}), "kruskal").pairDistances().pairs == 0);
+
+    // The same path with weights whose distances sum beyond 64 bits: w, w and 2w
+    Weight w = Weight(3) << 60;
+    PairDistanceStats wide = MST(Graph(FlatMatrix<Weight>(vector<vector<Weight>>{{0, w, 0}, {w, 0, w}, {0, w, 0}})), "kruskal").pairDistances();
+    CHECK(wide.sum == DistanceSum(w) * 4);
+    CHECK(wide.max == DistanceSum(w) * 2);
+    CHECK(wide.min == w);
+    CHECK(wide.mean == doctest::Approx(4.0 / 3 * w));
+    CHECK(wide.stddev == doctest::Approx(std::sqrt(2.0) / 3 * w));
+    CHECK(wide.report().find("Sum: 13835058055282163712\n") != std::string::npos);
+    CHECK(wide.report().find("Max: 6917529027641081856\n") != std::string::npos);
+
+    // A forest of two random trees and an isolated vertex, against every pair's tree path
+    const int n = 120;
+    std::mt19937 rng(11);
+    vector<vector<int>> adj_matrix(n, vector<int>(n, 0));
+    for (int v = 1; v < n - 1; v++)
+    {
+        if (v == n / 2)
+            continue;
+        int u = v < n / 2 ? rng() % v : n / 2 + rng() % (v - n / 2);
+        adj_matrix[u][v] = adj_matrix[v][u] = 1 + rng() % 1000;
+    }
+    MST mst(Graph(adj_matrix), "boruvka");
+    long long pairs = 0;
+    Weight sum = 0, min = std::numeric_limits<Weight>::max(), max = 0;
+    double squares = 0;
+    for (int s = 0; s < n; s++)
+    {
+        for (int e = s + 1; e < n; e++)
+        {
+            vector<int> path = mst.shortestPath(s, e);
+            if (path.empty())
+                continue;
+            Weight d = 0;
+            for (size_t i = 1; i < path.size(); i++)
+                d += adj_matrix[path[i - 1]][path[i]];
+            pairs++;
+            sum += d;
+            squares += (double)d * d;
+            min = std::min(min, d);
+            max = std::max(max, d);
+        }
+    }
+    PairDistanceStats stats = mst.pairDistances();
+    CHECK(stats.pairs == pairs);
+    CHECK(stats.sum == sum);
+    CHECK(stats.mean == doctest::Approx((double)sum / pairs));
+    double mean = (double)sum / pairs;
+    CHECK(stats.stddev == doctest::Approx(std::sqrt(squares / pairs - mean * mean)));
+    CHECK(stats.min == min);
+    CHECK(stats.max == max);
+}
@@ -0,0 +1,147 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// this is a class for a dense matrix kept in one 64-byte-aligned buffer instead of a vector per
+// row. Rows are padded to a stride that is a whole number of cache lines, so every row starts
+// on a line boundary and a row scan never shares a line with its neighbours. The padding is
+// zero, which reads as "no edge" for adjacency matrices.
+// m[i] is a pointer to row i, so m[i][j] reads the same as with nested vectors.
+template <typename T>
+class FlatMatrix
+{
+    static_assert(std::is_trivially_copyable_v<T>, "FlatMatrix holds plain values");
+
+public:
+    using value_type = T;
+    static constexpr size_t ALIGNMENT = 64;
+    static_assert(ALIGNMENT % sizeof(T) == 0, "A cache line must hold whole elements");
+
+    FlatMatrix() = default;
+
+    FlatMatrix(size_t rows, size_t cols, T value = T()) : rowCount(rows), colCount(cols), rowStride(strideFor(cols))
+    {
+        allocate();
+        std::fill_n(cells, rowCount * rowStride, T());
+        if (value != T())
+        {
+            for (size_t i = 0; i < rowCount; i++)
+                std::fill_n((*this)[i], colCount, value);
+        }
+    }
+
+    // Converts nested vectors, so code and tests that build matrices that way keep working
+    FlatMatrix(const std::vector<std::vector<T>> &nested)
+        : FlatMatrix(nested.size(), nested.empty() ? 0 : nested[0].size())
+    {
+        for (size_t i = 0; i < rowCount; i++)
+        {
+            if (nested[i].size() != colCount)
+                throw std::invalid_argument("Every row of the matrix must have the same length");
+            std::copy(nested[i].begin(), nested[i].end(), (*this)[i]);
+        }
+    }
+
+    // Converts every cell from another element type; the caller makes sure the values fit
+    template <typename Other>
+    explicit FlatMatrix(const FlatMatrix<Other> &other) : FlatMatrix(other.rows(), other.cols())
+    {
+        for (size_t i = 0; i < rowCount; i++)
+            std::transform(other[i], other[i] + colCount, (*this)[i], [](Other value)
+                           { return static_cast<T>(value); });
+    }
+
+    FlatMatrix(const FlatMatrix &other) : rowCount(other.rowCount), colCount(other.colCount), rowStride(other.rowStride)
+    {
+        allocate();
+        std::copy(other.cells, other.cells + rowCount * rowStride, cells);
+    }
+
+    FlatMatrix(FlatMatrix &&other) noexcept { swap(other); }
+
+    FlatMatrix &operator=(FlatMatrix other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    ~FlatMatrix()
+    {
+        if (cells)
+            ::operator delete(cells, std::align_val_t(ALIGNMENT));
+    }
+
+    void swap(FlatMatrix &other) noexcept
+    {
+        std::swap(rowCount, other.rowCount);
+        std::swap(colCount, other.colCount);
+        std::swap(rowStride, other.rowStride);
+        std::swap(cells, other.cells);
+    }
+
+    size_t size() const { return rowCount; } // Number of rows, like the nested vectors had
+    size_t rows() const { return rowCount; }
+    size_t cols() const { return colCount; }
+    size_t stride() const { return rowStride; } // Elements from one row start to the next
+    bool empty() const { return rowCount == 0; }
+
+    T *operator[](size_t row) { return cells + row * rowStride; }
+    const T *operator[](size_t row) const { return cells + row * rowStride; }
+    T *data() { return cells; }
+    const T *data() const { return cells; }
+
+    // Checked access, for indices that come from clients
+    T &at(size_t row, size_t col)
+    {
+        if (row >= rowCount || col >= colCount)
+            throw std::out_of_range("Matrix index out of range");
+        return (*this)[row][col];
+    }
+
+    std::vector<std::vector<T>> toVectors() const
+    {
+        std::vector<std::vector<T>> nested(rowCount);
+        for (size_t i = 0; i < rowCount; i++)
+            nested[i].assign((*this)[i], (*this)[i] + colCount);
+        return nested;
+    }
+
+    bool operator==(const FlatMatrix &other) const
+    {
+        if (rowCount != other.rowCount || colCount != other.colCount)
+            return false;
+        for (size_t i = 0; i < rowCount; i++)
+        {
+            if (!std::equal((*this)[i], (*this)[i] + colCount, other[i]))
+                return false;
+        }
+        return true;
+    }
+
+private:
+    size_t rowCount = 0;
+    size_t colCount = 0;
+    size_t rowStride = 0;
+    T *cells = nullptr;
+
+    static size_t strideFor(size_t cols)
+    {
+        const size_t perLine = ALIGNMENT / sizeof(T);
+        return (cols + perLine - 1) / perLine * perLine;
+    }
+
+    // One aligned buffer for all rows, padding included; the constructors fill it
+    void allocate()
+    {
+        size_t count = rowCount * rowStride;
+        if (count > 0)
+            cells = static_cast<T *>(::operator new(count * sizeof(T), std::align_val_t(ALIGNMENT)));
+    }
+};
+
+using Matrix = FlatMatrix<int>;
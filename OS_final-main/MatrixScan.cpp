@@ -0,0 +1,298 @@
+#include "MatrixScan.hpp"
+#include <array>
+#include <climits>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MATRIX_SCAN_X86 1
+#endif
+
+template <typename Cell>
+int cheapestInRowScalar(const Cell *row, const int *comp, int own, int n)
+{
+    int best = -1;
+    for (int j = 0; j < n; j++)
+    {
+        if (row[j] > 0 && comp[j] != own && (best == -1 || row[j] < row[best]))
+            best = j;
+    }
+    return best;
+}
+
+template <typename Cell>
+int edgeColumnsScalar(const Cell *row, int from, int n, int *cols)
+{
+    int count = 0;
+    for (int j = from; j < n; j++)
+    {
+        if (row[j] > 0)
+            cols[count++] = j;
+    }
+    return count;
+}
+
+#ifdef MATRIX_SCAN_X86
+
+// Loads 8 (AVX2) or 16 (AVX-512) cells, widened to 32-bit lanes
+__attribute__((target("avx2"))) static inline __m256i load8(const int *cells)
+{
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cells));
+}
+
+__attribute__((target("avx2"))) static inline __m256i load8(const uint16_t *cells)
+{
+    return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(cells)));
+}
+
+__attribute__((target("avx2"))) static inline __m256i load8(const uint8_t *cells)
+{
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(cells)));
+}
+
+__attribute__((target("avx512f"))) static inline __m512i load16(const int *cells)
+{
+    return _mm512_loadu_si512(cells);
+}
+
+__attribute__((target("avx512f"))) static inline __m512i load16(const uint16_t *cells)
+{
+    return _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(cells)));
+}
+
+__attribute__((target("avx512f"))) static inline __m512i load16(const uint8_t *cells)
+{
+    return _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(cells)));
+}
+
+// Merges the per-lane minimums of a vector kernel and finishes the columns after the last
+// full vector. Every lane kept its earliest column on ties, so ties go to the lowest column.
+template <typename Cell>
+static int reduceLanes(const int *laneWeight, const int *laneIndex, int lanes,
+                       const Cell *row, const int *comp, int own, int from, int n)
+{
+    int best = -1, bestWeight = INT_MAX;
+    for (int l = 0; l < lanes; l++)
+    {
+        if (laneIndex[l] != -1 && (best == -1 || laneWeight[l] < bestWeight ||
+                                   (laneWeight[l] == bestWeight && laneIndex[l] < best)))
+        {
+            best = laneIndex[l];
+            bestWeight = laneWeight[l];
+        }
+    }
+    for (int j = from; j < n; j++)
+    {
+        if (row[j] > 0 && comp[j] != own && (best == -1 || row[j] < bestWeight))
+        {
+            best = j;
+            bestWeight = row[j];
+        }
+    }
+    return best;
+}
+
+/**
+ * cheapestInRowAvx2
+ * Masked min-reduction over 8 columns at a time: a lane takes a column when it is an edge
+ * (weight > 0) to another component and is cheaper than the lane's best so far.
+ */
+template <typename Cell>
+__attribute__((target("avx2"))) static int cheapestInRowAvx2(const Cell *row, const int *comp, int own, int n)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i none = _mm256_set1_epi32(-1);
+    const __m256i ownComp = _mm256_set1_epi32(own);
+    const __m256i step = _mm256_set1_epi32(8);
+    __m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i best = _mm256_set1_epi32(INT_MAX);
+    __m256i bestIndex = none;
+
+    int j = 0;
+    for (; j + 8 <= n; j += 8)
+    {
+        __m256i weight = load8(row + j);
+        __m256i component = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(comp + j));
+        __m256i valid = _mm256_andnot_si256(_mm256_cmpeq_epi32(component, ownComp), _mm256_cmpgt_epi32(weight, zero));
+        __m256i better = _mm256_or_si256(_mm256_cmpgt_epi32(best, weight), _mm256_cmpeq_epi32(bestIndex, none));
+        __m256i take = _mm256_and_si256(valid, better);
+        best = _mm256_blendv_epi8(best, weight, take);
+        bestIndex = _mm256_blendv_epi8(bestIndex, index, take);
+        index = _mm256_add_epi32(index, step);
+    }
+
+    alignas(32) int laneWeight[8], laneIndex[8];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(laneWeight), best);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(laneIndex), bestIndex);
+    return reduceLanes(laneWeight, laneIndex, 8, row, comp, own, j, n);
+}
+
+// The same reduction over 16 columns at a time, with the masks in mask registers
+template <typename Cell>
+__attribute__((target("avx512f"))) static int cheapestInRowAvx512(const Cell *row, const int *comp, int own, int n)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i none = _mm512_set1_epi32(-1);
+    const __m512i ownComp = _mm512_set1_epi32(own);
+    const __m512i step = _mm512_set1_epi32(16);
+    __m512i index = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m512i best = _mm512_set1_epi32(INT_MAX);
+    __m512i bestIndex = none;
+
+    int j = 0;
+    for (; j + 16 <= n; j += 16)
+    {
+        __m512i weight = load16(row + j);
+        __m512i component = _mm512_loadu_si512(comp + j);
+        __mmask16 valid = _mm512_cmpgt_epi32_mask(weight, zero) & _mm512_cmpneq_epi32_mask(component, ownComp);
+        __mmask16 better = _mm512_cmpgt_epi32_mask(best, weight) | _mm512_cmpeq_epi32_mask(bestIndex, none);
+        __mmask16 take = valid & better;
+        best = _mm512_mask_mov_epi32(best, take, weight);
+        bestIndex = _mm512_mask_mov_epi32(bestIndex, take, index);
+        index = _mm512_add_epi32(index, step);
+    }
+
+    alignas(64) int laneWeight[16], laneIndex[16];
+    _mm512_store_si512(laneWeight, best);
+    _mm512_store_si512(laneIndex, bestIndex);
+    return reduceLanes(laneWeight, laneIndex, 16, row, comp, own, j, n);
+}
+
+// For every 8-bit mask, the lanes that are set, moved to the front: AVX2 has no compress
+// instruction, so the compaction permutes with this table
+static const auto COMPRESS_TABLE = []
+{
+    std::array<std::array<int, 8>, 256> table{};
+    for (int mask = 0; mask < 256; mask++)
+    {
+        int k = 0;
+        for (int lane = 0; lane < 8; lane++)
+        {
+            if (mask >> lane & 1)
+                table[mask][k++] = lane;
+        }
+    }
+    return table;
+}();
+
+/**
+ * edgeColumnsAvx2
+ * Compares 8 weights at a time with zero, then packs the column numbers of the edges to
+ * the front with a table-driven permute and stores the whole vector; only the first
+ * popcount(mask) values count, the rest is overwritten by the next store.
+ */
+template <typename Cell>
+__attribute__((target("avx2,popcnt"))) static int edgeColumnsAvx2(const Cell *row, int from, int n, int *cols)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i step = _mm256_set1_epi32(8);
+    __m256i index = _mm256_add_epi32(_mm256_set1_epi32(from), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    int count = 0, j = from;
+    for (; j + 8 <= n; j += 8)
+    {
+        __m256i weight = load8(row + j);
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(weight, zero)));
+        __m256i order = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(COMPRESS_TABLE[mask].data()));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(cols + count), _mm256_permutevar8x32_epi32(index, order));
+        count += __builtin_popcount(mask);
+        index = _mm256_add_epi32(index, step);
+    }
+    return count + edgeColumnsScalar(row, j, n, cols + count);
+}
+
+// The same compaction 16 columns at a time with the compress instruction
+template <typename Cell>
+__attribute__((target("avx512f,popcnt"))) static int edgeColumnsAvx512(const Cell *row, int from, int n, int *cols)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i step = _mm512_set1_epi32(16);
+    __m512i index = _mm512_add_epi32(_mm512_set1_epi32(from),
+                                     _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+    int count = 0, j = from;
+    for (; j + 16 <= n; j += 16)
+    {
+        __mmask16 mask = _mm512_cmpgt_epi32_mask(load16(row + j), zero);
+        _mm512_storeu_si512(cols + count, _mm512_maskz_compress_epi32(mask, index));
+        count += __builtin_popcount(mask);
+        index = _mm512_add_epi32(index, step);
+    }
+    return count + edgeColumnsScalar(row, j, n, cols + count);
+}
+
+#endif
+
+template <typename Cell>
+struct ScanKernels
+{
+    const char *name;
+    int (*cheapestInRow)(const Cell *, const int *, int, int);
+    int (*edgeColumns)(const Cell *, int, int, int *);
+};
+
+// Cells whose values all fit the signed 32-bit lanes of the vector kernels
+template <typename Cell>
+static constexpr bool FITS_LANES = std::is_same_v<Cell, uint8_t> || std::is_same_v<Cell, uint16_t> || std::is_same_v<Cell, int>;
+
+// Checked once per cell type; the CPU does not change under a running process.
+// uint32_t and int64_t cells only hold weights beyond int and are scanned scalar.
+template <typename Cell>
+static ScanKernels<Cell> pickKernels()
+{
+#ifdef MATRIX_SCAN_X86
+    if constexpr (FITS_LANES<Cell>)
+    {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+            return {"avx512", cheapestInRowAvx512<Cell>, edgeColumnsAvx512<Cell>};
+        if (__builtin_cpu_supports("avx2"))
+            return {"avx2", cheapestInRowAvx2<Cell>, edgeColumnsAvx2<Cell>};
+    }
+#endif
+    return {"scalar", cheapestInRowScalar<Cell>, edgeColumnsScalar<Cell>};
+}
+
+template <typename Cell>
+static const ScanKernels<Cell> &kernels()
+{
+    static const ScanKernels<Cell> picked = pickKernels<Cell>();
+    return picked;
+}
+
+template <typename Cell>
+int cheapestInRow(const Cell *row, const int *comp, int own, int n)
+{
+    return kernels<Cell>().cheapestInRow(row, comp, own, n);
+}
+
+template <typename Cell>
+int edgeColumns(const Cell *row, int from, int n, int *cols)
+{
+    return kernels<Cell>().edgeColumns(row, from, n, cols);
+}
+
+const char *matrixScanKernel()
+{
+    return kernels<int>().name;
+}
+
+// The cell types of Graph's weight matrix
+template int cheapestInRow<uint8_t>(const uint8_t *, const int *, int, int);
+template int cheapestInRow<uint16_t>(const uint16_t *, const int *, int, int);
+template int cheapestInRow<int>(const int *, const int *, int, int);
+template int cheapestInRow<uint32_t>(const uint32_t *, const int *, int, int);
+template int cheapestInRow<int64_t>(const int64_t *, const int *, int, int);
+template int cheapestInRowScalar<uint8_t>(const uint8_t *, const int *, int, int);
+template int cheapestInRowScalar<uint16_t>(const uint16_t *, const int *, int, int);
+template int cheapestInRowScalar<int>(const int *, const int *, int, int);
+template int cheapestInRowScalar<uint32_t>(const uint32_t *, const int *, int, int);
+template int cheapestInRowScalar<int64_t>(const int64_t *, const int *, int, int);
+template int edgeColumns<uint8_t>(const uint8_t *, int, int, int *);
+template int edgeColumns<uint16_t>(const uint16_t *, int, int, int *);
+template int edgeColumns<int>(const int *, int, int, int *);
+template int edgeColumns<uint32_t>(const uint32_t *, int, int, int *);
+template int edgeColumns<int64_t>(const int64_t *, int, int, int *);
+template int edgeColumnsScalar<uint8_t>(const uint8_t *, int, int, int *);
+template int edgeColumnsScalar<uint16_t>(const uint16_t *, int, int, int *);
+template int edgeColumnsScalar<int>(const int *, int, int, int *);
+template int edgeColumnsScalar<uint32_t>(const uint32_t *, int, int, int *);
+template int edgeColumnsScalar<int64_t>(const int64_t *, int, int, int *);
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+
+// Vectorized scans over the rows of a dense adjacency matrix, for every cell type a Graph
+// stores (see Graph.hpp). Each kernel comes as AVX-512, AVX2 and scalar code; the first call
+// picks the widest one the CPU supports. Narrow cells are widened to 32-bit lanes as they are
+// loaded, next to the 32-bit component ids and column numbers. uint32_t and int64_t cells do
+// not fit those lanes and always take the scalar code.
+
+/**
+ * cheapestInRow
+ * Finds the cheapest edge in one matrix row that leaves a component: the column j with
+ * row[j] > 0 and comp[j] != own of the lowest weight, the lowest j among equal weights.
+ *
+ * @param row The matrix row, n weights (0 = no edge).
+ * @param comp The component of every vertex.
+ * @param own The component of the row's vertex.
+ * @param n The number of columns.
+ * @return The column of the cheapest edge, or -1 if the row has none.
+ */
+template <typename Cell>
+int cheapestInRow(const Cell *row, const int *comp, int own, int n);
+
+template <typename Cell>
+int cheapestInRowScalar(const Cell *row, const int *comp, int own, int n); // Reference for the tests
+
+// Extra room edgeColumns may write past the columns it reports: the vector kernels store whole vectors
+static const int EDGE_COLUMNS_SLACK = 16;
+
+/**
+ * edgeColumns
+ * Compacts the columns j in [from, n) with row[j] > 0 into cols, in increasing order.
+ *
+ * @param cols Room for n - from + EDGE_COLUMNS_SLACK values.
+ * @return The number of columns written.
+ */
+template <typename Cell>
+int edgeColumns(const Cell *row, int from, int n, int *cols);
+
+template <typename Cell>
+int edgeColumnsScalar(const Cell *row, int from, int n, int *cols); // Reference for the tests
+
+// Name of the kernel the scans dispatch to: "avx512", "avx2" or "scalar"
+const char *matrixScanKernel();
@@ -0,0 +1,210 @@
+#include "MemoryBudget.hpp"
+#include <sstream>
+
+using namespace std;
+
+MemoryBudget::MemoryBudget(size_t budget) : limit(budget), hand(clock.end())
+{
+    counters.budget = budget;
+    if (limit > 0)
+        evictor = thread([this]()
+                         { evictLoop(); });
+}
+
+MemoryBudget::~MemoryBudget()
+{
+    {
+        lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        wake.notify_one();
+    }
+    if (evictor.joinable())
+        evictor.join();
+}
+
+void MemoryBudget::account(const Entry &entry, bool add)
+{
+    MemoryStats::Kind &kind = counters.kinds[static_cast<int>(entry.kind)];
+    size_t bytes = entry.use.data + entry.use.index;
+    if (add)
+    {
+        kind.entries++;
+        kind.dataBytes += entry.use.data;
+        kind.indexBytes += entry.use.index;
+        counters.used += bytes;
+    }
+    else
+    {
+        kind.entries--;
+        kind.dataBytes -= entry.use.data;
+        kind.indexBytes -= entry.use.index;
+        counters.used -= bytes;
+    }
+    if (limit > 0 && counters.used > limit)
+    {
+        overBudget = true;
+        wake.notify_one();
+    }
+}
+
+MemoryBudget::Charge MemoryBudget::charge(MemoryKind kind, MemoryUse use, function<bool()> evict)
+{
+    auto entry = make_shared<Entry>();
+    entry->kind = kind;
+    entry->use = use;
+    entry->evict = std::move(evict);
+
+    Charge charge;
+    charge.budget = this;
+    charge.entry = entry;
+    lock_guard<std::mutex> lock(mutex);
+    entry->position = clock.insert(hand, entry); // Just behind the hand: the last one it reaches
+    account(*entry, true);
+    return charge;
+}
+
+MemoryBudget::Charge::Charge(Charge &&other) noexcept : budget(other.budget), entry(std::move(other.entry))
+{
+    other.budget = nullptr;
+}
+
+MemoryBudget::Charge &MemoryBudget::Charge::operator=(Charge &&other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        budget = other.budget;
+        entry = std::move(other.entry);
+        other.budget = nullptr;
+    }
+    return *this;
+}
+
+MemoryBudget::Charge::~Charge()
+{
+    release();
+}
+
+void MemoryBudget::Charge::release()
+{
+    if (!entry)
+        return;
+    {
+        lock_guard<std::mutex> lock(budget->mutex);
+        if (budget->hand == entry->position)
+            ++budget->hand;
+        budget->clock.erase(entry->position);
+        entry->released = true;
+        budget->account(*entry, false);
+    }
+    entry.reset();
+    budget = nullptr;
+}
+
+void MemoryBudget::Charge::resize(MemoryUse use)
+{
+    if (!entry)
+        return;
+    lock_guard<std::mutex> lock(budget->mutex);
+    budget->account(*entry, false);
+    entry->use = use;
+    budget->account(*entry, true);
+    entry->referenced.store(true, memory_order_relaxed);
+}
+
+void MemoryBudget::Charge::touch()
+{
+    if (entry)
+        entry->referenced.store(true, memory_order_relaxed);
+}
+
+void MemoryBudget::hit(MemoryKind kind)
+{
+    lock_guard<std::mutex> lock(mutex);
+    counters.kinds[static_cast<int>(kind)].hits++;
+}
+
+void MemoryBudget::miss(MemoryKind kind)
+{
+    lock_guard<std::mutex> lock(mutex);
+    counters.kinds[static_cast<int>(kind)].misses++;
+}
+
+void MemoryBudget::enforce()
+{
+    lock_guard<std::mutex> sweep(sweeping);
+    unique_lock<std::mutex> lock(mutex);
+    overBudget = false;
+    // Each entry gets one try, so entries in use cannot keep the hand going round
+    size_t tries = clock.size();
+    while (limit > 0 && counters.used > limit && tries > 0)
+    {
+        // Two turns of the hand reach every evictable entry with its reference bit cleared
+        shared_ptr<Entry> victim;
+        for (size_t step = 0; step < 2 * clock.size() && !victim; step++)
+        {
+            if (hand == clock.end())
+                hand = clock.begin();
+            auto current = hand++;
+            Entry &entry = **current;
+            if (!entry.evict || entry.evicting || entry.referenced.exchange(false, memory_order_relaxed))
+                continue;
+            victim = *current;
+        }
+        if (!victim)
+            break;
+        tries--;
+        victim->evicting = true;
+        lock.unlock();
+        bool evicted = victim->evict(); // Destroys the charge, which takes the lock
+        lock.lock();
+        victim->evicting = false;
+        if (evicted)
+            counters.kinds[static_cast<int>(victim->kind)].evictions++;
+    }
+}
+
+/**
+ * evictLoop
+ * Runs on the evictor thread: sweeps whenever a charge grew past the budget, so the request
+ * that grew it goes on without waiting for the evictions.
+ */
+void MemoryBudget::evictLoop()
+{
+    unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        wake.wait(lock, [this]()
+                  { return overBudget || stopping; });
+        if (stopping)
+            return;
+        lock.unlock();
+        enforce();
+        lock.lock();
+    }
+}
+
+MemoryStats MemoryBudget::stats() const
+{
+    lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+string MemoryBudget::report() const
+{
+    MemoryStats now = stats();
+    ostringstream out;
+    out << "Memory: " << now.used << " bytes used";
+    if (now.budget > 0)
+        out << " of a budget of " << now.budget;
+    out << "\n";
+    const char *names[] = {"Graphs: ", "MSTs: "};
+    const char *entries[] = {" resident, ", " cached, "};
+    for (int kind = 0; kind < 2; kind++)
+    {
+        const MemoryStats::Kind &k = now.kinds[kind];
+        out << names[kind] << k.entries << entries[kind] << k.dataBytes << " bytes and " << k.indexBytes
+            << " bytes of indexes; " << k.hits << " hits, " << k.misses << " misses, " << k.evictions << " evictions\n";
+    }
+    return out.str();
+}
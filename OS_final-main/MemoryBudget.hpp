@@ -0,0 +1,126 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// What a MemoryBudget accounts for
+enum class MemoryKind
+{
+    Graph, // Resident graphs: the weight matrix and its edge bitset
+    Mst,   // Cached MSTs: the tree edges and the rooted tree the path queries walk
+};
+
+// Bytes of one entry: its data and the indexes built over it
+struct MemoryUse
+{
+    size_t data = 0;
+    size_t index = 0;
+};
+
+// this is a struct that holds the counters of a MemoryBudget at one moment
+struct MemoryStats
+{
+    size_t budget = 0; // 0 for none
+    size_t used = 0;
+    struct Kind
+    {
+        size_t entries = 0;
+        size_t dataBytes = 0;
+        size_t indexBytes = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+    } kinds[2]; // By MemoryKind
+};
+
+/**
+ * Class: MemoryBudget
+ * Accounts for the resident graphs and cached MSTs of a server against a budget (--memory).
+ * Every entry holds a Charge of its bytes. Once they add up to more than the budget an
+ * evictor thread frees cold entries in CLOCK order until they fit again: an entry used since
+ * the hand last passed it gets a second chance, any other is evicted. Requests only set a
+ * reference bit and never wait for an eviction. Without a budget the bytes and counters are
+ * kept all the same.
+ */
+class MemoryBudget
+{
+    struct Entry;
+
+public:
+    // this is a class that holds the charge of one entry for as long as the entry lives
+    class Charge
+    {
+    public:
+        Charge() = default; // Charges nothing
+        Charge(Charge &&other) noexcept;
+        Charge &operator=(Charge &&other) noexcept;
+        ~Charge();
+
+        void resize(MemoryUse use); // The entry grew or shrank
+        void touch();               // The entry was used: it survives the next pass of the hand
+
+    private:
+        friend class MemoryBudget;
+        MemoryBudget *budget = nullptr;
+        std::shared_ptr<Entry> entry;
+        void release();
+    };
+
+    explicit MemoryBudget(size_t budget = 0); // In bytes, 0 for none
+    ~MemoryBudget();
+    MemoryBudget(const MemoryBudget &) = delete;
+    MemoryBudget &operator=(const MemoryBudget &) = delete;
+
+    /**
+     * charge
+     * Starts accounting for an entry. The budget must outlive the charge.
+     *
+     * @param evict Frees the entry, which destroys its charge, and returns true; or returns
+     *              false if the entry is in use. Called on the evictor thread without any lock
+     *              of the budget held. Empty for an entry that is never evicted.
+     */
+    Charge charge(MemoryKind kind, MemoryUse use, std::function<bool()> evict = nullptr);
+
+    void hit(MemoryKind kind);  // A lookup found the entry resident
+    void miss(MemoryKind kind); // A lookup had to build or load the entry
+
+    // Evicts cold entries until the charges fit the budget or nothing more can be evicted.
+    // The evictor thread runs it whenever they outgrow the budget; it returns after the sweep
+    // already under way, if any.
+    void enforce();
+
+    MemoryStats stats() const;
+    std::string report() const; // The stats, as the server's memory option shows them
+
+private:
+    struct Entry
+    {
+        MemoryKind kind;
+        MemoryUse use;
+        std::function<bool()> evict;
+        std::atomic<bool> referenced{true}; // Used since the hand last passed
+        bool evicting = false;
+        bool released = false;
+        std::list<std::shared_ptr<Entry>>::iterator position; // In clock
+    };
+
+    size_t limit;
+    mutable std::mutex mutex;
+    std::mutex sweeping;              // One sweep at a time, so two do not evict for the same excess
+    std::condition_variable wake;     // Over budget, or stopping
+    std::list<std::shared_ptr<Entry>> clock; // Every live entry, in the order the hand visits them
+    std::list<std::shared_ptr<Entry>>::iterator hand;
+    MemoryStats counters;
+    bool overBudget = false; // A charge grew past the budget since the last sweep
+    bool stopping = false;
+    std::thread evictor;
+
+    void evictLoop();
+    void account(const Entry &entry, bool add); // Adds or removes the bytes of the entry
+};
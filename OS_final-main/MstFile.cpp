@@ -0,0 +1,180 @@
+#include "MstFile.hpp"
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+// One tree edge as it is stored
+struct MstFileEdge
+{
+    int32_t u;
+    int32_t v;
+    int64_t w;
+};
+static_assert(sizeof(MstFileEdge) == 16);
+
+// Byte positions of the sections of a tree of n vertices and m edges
+struct MstFileLayout
+{
+    uint64_t edges, parent, parentWeight, depth, childStart, children, end;
+
+    MstFileLayout(uint64_t n, uint64_t m)
+    {
+        edges = alignSection(sizeof(MstFileHeader));
+        parent = alignSection(edges + m * sizeof(MstFileEdge));
+        parentWeight = alignSection(parent + n * sizeof(int32_t));
+        depth = alignSection(parentWeight + n * sizeof(int64_t));
+        childStart = alignSection(depth + n * sizeof(int32_t));
+        children = alignSection(childStart + (n + 1) * sizeof(int32_t));
+        end = children + m * sizeof(int32_t);
+    }
+};
+
+static uint64_t headerChecksum(const MstFileHeader &header)
+{
+    return graphFileChecksum(&header, offsetof(MstFileHeader, headerChecksum));
+}
+
+void MstFile::save(const MST &mst, MstAlgorithm algorithm, GraphVersion version, const string &path)
+{
+    uint64_t n = mst.vertexCount, m = mst.treeEdges.size();
+    MstFileLayout layout(n, m);
+    vector<unsigned char> file(layout.end, 0);
+    auto section = [&](uint64_t at)
+    { return file.data() + at; };
+
+    MstFileEdge *edges = reinterpret_cast<MstFileEdge *>(section(layout.edges));
+    for (const auto &[u, v, w] : mst.treeEdges)
+        *edges++ = MstFileEdge{u, v, w};
+    memcpy(section(layout.parent), mst.parent.data(), n * sizeof(int32_t));
+    memcpy(section(layout.parentWeight), mst.parentWeight.data(), n * sizeof(int64_t));
+    memcpy(section(layout.depth), mst.depth.data(), n * sizeof(int32_t));
+    memcpy(section(layout.childStart), mst.childStart.data(), (n + 1) * sizeof(int32_t));
+    memcpy(section(layout.children), mst.children.data(), m * sizeof(int32_t));
+
+    MstFileHeader header{};
+    memcpy(header.magic, MstFileHeader::MAGIC, sizeof(header.magic));
+    header.version = MstFileHeader::VERSION;
+    header.byteOrder = GraphFileHeader::ENDIAN_MARK;
+    header.algorithm = static_cast<uint32_t>(algorithm);
+    header.graphSnapshot = version.snapshot;
+    header.graphMutations = version.mutations;
+    header.vertices = n;
+    header.edges = m;
+    header.sectionsAt = layout.edges;
+    header.fileSize = layout.end;
+    header.sectionsChecksum = graphFileChecksum(section(layout.edges), layout.end - layout.edges);
+    header.headerChecksum = headerChecksum(header);
+    memcpy(file.data(), &header, sizeof(header));
+
+    // A name of its own: sessions that missed the cache together may save the same tree at once
+    string temporary = path + ".XXXXXX";
+    int fd = ::mkostemp(temporary.data(), O_CLOEXEC);
+    if (fd < 0)
+        throw runtime_error("Cannot create a temporary file for " + path + ": " + strerror(errno));
+    try
+    {
+        if (::fchmod(fd, 0644) < 0)
+            throw runtime_error("Cannot set the mode of " + temporary + ": " + strerror(errno));
+        writeAll(fd, file.data(), file.size(), temporary);
+        if (::fsync(fd) < 0)
+            throw runtime_error("Cannot sync " + temporary + ": " + strerror(errno));
+        if (::rename(temporary.c_str(), path.c_str()) < 0)
+            throw runtime_error("Cannot rename " + temporary + " to " + path + ": " + strerror(errno));
+    }
+    catch (...)
+    {
+        ::close(fd);
+        ::unlink(temporary.c_str());
+        throw;
+    }
+    ::close(fd);
+}
+
+// Whether the header is intact and describes a file of fileSize bytes
+static bool validHeader(const MstFileHeader &header, uint64_t fileSize)
+{
+    if (memcmp(header.magic, MstFileHeader::MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != MstFileHeader::VERSION || header.byteOrder != GraphFileHeader::ENDIAN_MARK ||
+        header.headerChecksum != headerChecksum(header))
+        return false;
+    if (header.vertices > INT_MAX || header.edges > header.vertices)
+        return false;
+    MstFileLayout layout(header.vertices, header.edges);
+    return header.sectionsAt == layout.edges && header.fileSize == layout.end && fileSize == layout.end;
+}
+
+unique_ptr<MST> MstFile::load(MstAlgorithm algorithm, GraphVersion version, const string &path)
+{
+    if (::access(path.c_str(), F_OK) < 0)
+        return nullptr;
+    try
+    {
+        MappedFile file(path);
+        if (file.size() < sizeof(MstFileHeader))
+            return nullptr;
+        const MstFileHeader &header = *reinterpret_cast<const MstFileHeader *>(file.bytes());
+        if (!validHeader(header, file.size()) || header.algorithm != static_cast<uint32_t>(algorithm) ||
+            GraphVersion{header.graphSnapshot, header.graphMutations} != version)
+            return nullptr;
+        MstFileLayout layout(header.vertices, header.edges);
+        if (graphFileChecksum(file.bytes() + layout.edges, layout.end - layout.edges) != header.sectionsChecksum)
+            return nullptr;
+
+        size_t n = header.vertices, m = header.edges;
+        auto section = [&](uint64_t at)
+        { return file.bytes() + at; };
+        unique_ptr<MST> mst(new MST());
+        mst->vertexCount = n;
+        const MstFileEdge *edges = reinterpret_cast<const MstFileEdge *>(section(layout.edges));
+        mst->treeEdges.reserve(m);
+        for (size_t k = 0; k < m; k++)
+            mst->treeEdges.emplace_back(edges[k].u, edges[k].v, edges[k].w);
+        auto copy = [&](auto &target, uint64_t at, size_t count)
+        {
+            using Value = typename decay_t<decltype(target)>::value_type;
+            const Value *values = reinterpret_cast<const Value *>(section(at));
+            target.assign(values, values + count);
+        };
+        copy(mst->parent, layout.parent, n);
+        copy(mst->parentWeight, layout.parentWeight, n);
+        copy(mst->depth, layout.depth, n);
+        copy(mst->childStart, layout.childStart, n + 1);
+        copy(mst->children, layout.children, m);
+        return mst;
+    }
+    catch (const runtime_error &e)
+    {
+        cerr << e.what() << endl;
+        return nullptr;
+    }
+}
+
+bool MstFile::rekey(GraphVersion from, GraphVersion to, const string &path)
+{
+    int fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    MstFileHeader header;
+    off_t size = ::lseek(fd, 0, SEEK_END);
+    bool matches = ::pread(fd, &header, sizeof(header), 0) == sizeof(header) && size >= 0 &&
+                   validHeader(header, size) && GraphVersion{header.graphSnapshot, header.graphMutations} == from;
+    if (matches)
+    {
+        header.graphSnapshot = to.snapshot;
+        header.graphMutations = to.mutations;
+        header.headerChecksum = headerChecksum(header);
+        // A torn header fails its checksum, and the file is then rebuilt like a stale one
+        matches = ::pwrite(fd, &header, sizeof(header), 0) == sizeof(header) && ::fdatasync(fd) == 0;
+    }
+    ::close(fd);
+    return matches;
+}
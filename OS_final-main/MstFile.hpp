@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "GraphFile.hpp"
+#include "MST.hpp"
+
+// The binary MST file, version 1: a built MST with the indexes its queries walk, so a server
+// can answer them after a restart without rebuilding it. The sections follow the header in
+// this order, each starting on a 64-byte boundary:
+//   edges        edges x (int32_t u, int32_t v, int64_t w)  the tree edges, u < v, sorted
+//   parent       vertices x int32_t                          -1 for the roots
+//   parentWeight vertices x int64_t
+//   depth        vertices x int32_t
+//   childStart   (vertices + 1) x int32_t                    children of v start at childStart[v]
+//   children     edges x int32_t
+// The file names the graph version it was built from, and loads only for that version.
+struct MstFileHeader
+{
+    static constexpr char MAGIC[8] = {'M', 'S', 'T', 'T', 'R', 'E', 'E', 'S'};
+    static const uint32_t VERSION = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder; // GraphFileHeader::ENDIAN_MARK
+    uint32_t algorithm; // MstAlgorithm
+    uint32_t unused;
+    uint64_t graphSnapshot; // GraphVersion of the graph the tree was built from
+    uint64_t graphMutations;
+    uint64_t vertices;
+    uint64_t edges;
+    uint64_t sectionsAt; // Byte position of the edges, the first section
+    uint64_t fileSize;
+    uint64_t sectionsChecksum; // Of the bytes from sectionsAt to the end
+    uint64_t headerChecksum;   // Of every field above
+};
+
+// this is a class that saves and loads MSTs as MST files; it reads and fills in their private parts
+class MstFile
+{
+public:
+    /**
+     * save
+     * Writes the MST to a temporary file of its own next to path, syncs it, and renames it over
+     * path, so saves of the same path at once each put a whole file in place.
+     *
+     * @throws runtime_error if the file cannot be written.
+     */
+    static void save(const MST &mst, MstAlgorithm algorithm, GraphVersion version, const std::string &path);
+
+    /**
+     * load
+     * Maps the file and rebuilds the MST from it, if it holds the tree of the algorithm for
+     * that graph version. The indexes are copied as they are; nothing is recomputed.
+     *
+     * @return The MST, or null if the file does not exist, is of another version or algorithm,
+     *         or fails a check.
+     */
+    static std::unique_ptr<MST> load(MstAlgorithm algorithm, GraphVersion version, const std::string &path);
+
+    /**
+     * rekey
+     * Moves the file from one graph version to another holding the same graph, as a
+     * checkpoint does, by rewriting its header in place.
+     *
+     * @return Whether the file existed and was of version from.
+     */
+    static bool rekey(GraphVersion from, GraphVersion to, const std::string &path);
+};
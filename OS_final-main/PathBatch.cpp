@@ -0,0 +1,135 @@
+#include "PathBatch.hpp"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+
+using namespace std;
+
+// Tasks one block of pairs is split into; a few per worker so stealing evens out long paths
+static const size_t TASKS_PER_BLOCK = 64;
+static const size_t MAX_BLOCK_PAIRS = 1 << 16;
+
+bool PairReader::feed(string_view text)
+{
+    // Appends the number in partial once whitespace ends it; values beyond the count are ignored
+    auto endNumber = [this]()
+    {
+        if (partial.empty())
+            return true;
+        int value = 0;
+        auto [end, error] = from_chars(partial.data(), partial.data() + partial.size(), value);
+        if (error != errc() || end != partial.data() + partial.size())
+            return false;
+        if (!complete())
+            values.push_back(value);
+        partial.clear();
+        return true;
+    };
+
+    for (char c : text)
+    {
+        if (isspace(static_cast<unsigned char>(c)))
+        {
+            if (!endNumber())
+                return false;
+        }
+        else if (isdigit(static_cast<unsigned char>(c)) || c == '-')
+        {
+            if (partial.size() > 11) // Longer than any int
+                return false;
+            partial.push_back(c);
+        }
+        else
+            return false;
+    }
+    return true;
+}
+
+vector<pair<int, int>> PairReader::take()
+{
+    vector<pair<int, int>> pairs;
+    pairs.reserve(values.size() / 2);
+    for (size_t i = 0; i + 1 < values.size(); i += 2)
+        pairs.emplace_back(values[i], values[i + 1]);
+    values.clear();
+    return pairs;
+}
+
+size_t firstInvalidPair(const vector<pair<int, int>> &pairs, int vertices)
+{
+    for (size_t i = 0; i < pairs.size(); i++)
+    {
+        if (pairs[i].first < 0 || pairs[i].first >= vertices || pairs[i].second < 0 || pairs[i].second >= vertices)
+            return i;
+    }
+    return pairs.size();
+}
+
+// Formats an integer at the end of text with std::to_chars
+static void appendInteger(string &text, int64_t value)
+{
+    char digits[24];
+    char *end = to_chars(digits, digits + sizeof(digits), value).ptr;
+    text.append(digits, end);
+}
+
+/**
+ * next
+ * Answers the next blocks of pairs until `budget` bytes are buffered. The tasks of a block
+ * each answer a contiguous run of its pairs into their own buffer with their own two path
+ * vectors, so they share nothing but the MST, which they only read.
+ */
+bool PathBatch::next(ChunkWriter &out, size_t budget)
+{
+    while (!done() && out.size() < budget)
+    {
+        size_t count = min(blockPairs, pairs.size() - nextPair);
+        size_t perTask = pool ? (count + TASKS_PER_BLOCK - 1) / TASKS_PER_BLOCK : count;
+        size_t tasks = (count + perTask - 1) / perTask;
+        if (parts.size() < tasks)
+            parts.resize(tasks);
+
+        size_t first = nextPair;
+        auto answer = [&](size_t lo, size_t hi)
+        {
+            vector<int> path, scratch;
+            for (size_t task = lo; task < hi; task++)
+            {
+                string &text = parts[task];
+                text.clear();
+                size_t end = min(first + (task + 1) * perTask, first + count);
+                for (size_t i = first + task * perTask; i < end; i++)
+                {
+                    Weight weight = mst->treePathInto(pairs[i].first, pairs[i].second, path, scratch);
+                    appendInteger(text, pairs[i].first);
+                    text.push_back(' ');
+                    appendInteger(text, pairs[i].second);
+                    text.push_back(' ');
+                    appendInteger(text, weight);
+                    text.push_back(':');
+                    for (int v : path)
+                    {
+                        text.push_back(' ');
+                        appendInteger(text, v);
+                    }
+                    text.push_back('\n');
+                }
+            }
+        };
+        if (pool && tasks > 1)
+            pool->parallelFor(0, tasks, 1, answer);
+        else
+            answer(0, tasks);
+
+        size_t bytes = 0;
+        for (size_t task = 0; task < tasks; task++)
+        {
+            out.append(parts[task]);
+            bytes += parts[task].size();
+        }
+        nextPair += count;
+        if (bytes < budget / 2 && blockPairs < MAX_BLOCK_PAIRS)
+            blockPairs *= 2; // Short paths: fewer, larger blocks keep the pool busy
+    }
+    return !done();
+}
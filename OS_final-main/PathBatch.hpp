@@ -0,0 +1,54 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "MST.hpp"
+#include "Serializer.hpp"
+#include "WorkStealingPool.hpp"
+
+// Pairs one batch query may hold; bounds the memory a client can make the server set aside
+static const size_t MAX_BATCH_PAIRS = 1 << 22;
+
+// this is a class that reads the vertex pairs of a batch query from the client's input. The
+// input arrives in pieces of any size, so a number cut off at the end of one piece is kept
+// until the next one completes it; the last pair ends with a newline like any other input.
+class PairReader
+{
+public:
+    explicit PairReader(size_t count) : count(count) { values.reserve(2 * count); }
+    bool feed(std::string_view text); // false on anything but integers and whitespace
+    bool complete() const { return values.size() == 2 * count; }
+    std::vector<std::pair<int, int>> take();
+
+private:
+    size_t count;
+    std::vector<int> values;
+    std::string partial; // A number not yet ended by whitespace
+};
+
+// Index of the first pair with a vertex outside [0, vertices), or pairs.size() if there is none
+size_t firstInvalidPair(const std::vector<std::pair<int, int>> &pairs, int vertices);
+
+// this is a class that answers a batch of path queries against one MST, one
+// "source end weight: path" line per pair in the order of the pairs (weight -1 and no path for
+// vertices in different components). Each call of next evaluates a block of pairs in parallel
+// on the pool, every task into its own buffer, and appends the buffers in order; the block
+// grows until one call fills about a response batch.
+class PathBatch : public BatchSerializer
+{
+public:
+    PathBatch(std::shared_ptr<const MST> mst, std::vector<std::pair<int, int>> pairs, WorkStealingPool *pool = nullptr)
+        : mst(std::move(mst)), pairs(std::move(pairs)), pool(pool) {}
+    bool next(ChunkWriter &out, size_t budget) override;
+    bool done() const override { return nextPair == pairs.size(); }
+
+private:
+    std::shared_ptr<const MST> mst; // The snapshot every pair is answered from
+    std::vector<std::pair<int, int>> pairs;
+    WorkStealingPool *pool;
+    size_t nextPair = 0;
+    size_t blockPairs = 1024;
+    std::vector<std::string> parts; // One per task of a block, kept for their capacity
+};
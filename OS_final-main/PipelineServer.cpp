@@ -10,11 +10,27 @@
 #include <sstream>            
 #include <vector>             
 #include "Graph.hpp"         
+#include "GraphRegistry.hpp"
 #include "MST.hpp"            
+#include "WorkStealingPool.hpp"
+#include "ServerConfig.hpp"
+#include "Acceptor.hpp"
+#include "EventLoop.hpp"
+#include "Serializer.hpp"
+#include "Arena.hpp"
+#include "PathBatch.hpp"
+#include <cctype>
+#include <charconv>
+#include <memory_resource>
+#include <string_view>
 #include <csignal>
+#include <atomic>
+#include <map>
+#include <memory>
+
+#define PORT 8099 // default port, can be changed with --port
+std::atomic<bool> close_server{false};
 
-#define PORT 8099 
-bool close_server=false;
 //this is ActiveObject class that will be used to implement the pipeline pattern
 class ActiveObject
 {
@@ -85,52 +101,477 @@ public:
 };
 
 /**
- * Function: menu
- * Generates and returns the menu string that will be displayed to the client.
- * The menu presents options to perform different actions on the graph.
+ * Function: parseInts
+ * Reads `count` whitespace-separated integers from the start of a line with std::from_chars,
+ * without the stream and locale machinery of istringstream. Trailing text is ignored.
  *
- * @returns A string containing the menu options.
+ * @returns false if the line holds fewer than `count` integers.
  */
-std::string menu()
+template <typename Integer>
+static bool parseInts(std::string_view line, Integer *out, size_t count)
 {
-    std::stringstream ss;
-      "Options:\n"
-            "0. Shut down the server\n"
-            "1. Initialize a new graph (input adjacency matrix)\n"
-            "2. Insert an edge (input: source, destination, weight)\n"
-            "3. Delete an edge (input: source, destination)\n"
-            "4. Calculate the total weight of the MST\n"
-            "5. Find the longest path in the MST (input: source, end nodes)\n"
-            "6. Find the shortest path in the MST (input: source, end nodes)\n"
-            "7. Compute the average edge weight in the MST\n"
-            "8. Display the MST (adjacency matrix format)\n"
-            "9. Disconnect from the server\n";
-            // Option 9: Exit the program
-    return ss.str();                                               // Converts the stringstream to a string and returns it
+    const char *pos = line.data(), *end = line.data() + line.size();
+    for (size_t i = 0; i < count; i++)
+    {
+        while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\r' || *pos == '\n'))
+            pos++;
+        auto [next, error] = std::from_chars(pos, end, out[i]);
+        if (error != std::errc() || (next < end && !std::isspace(static_cast<unsigned char>(*next))))
+            return false;
+        pos = next;
+    }
+    return true;
 }
 
+/**
+ * Struct: Request
+ * One client request travelling through the pipeline. The session fills in the raw input
+ * lines, and each stage reads what the previous stage produced and adds its own part.
+ * The input, the parsed matrix and the scratch space of the MST construction come from the
+ * connection's arena; the stages touch them one after another, never at the same time.
+ */
+struct Request
+{
+    explicit Request(std::pmr::memory_resource *arena) : arena(arena), input(arena), adjMat(arena) {}
+
+    // Empties the arena-backed members, so the arena can be reset while a stage still holds the request
+    void releaseArena()
+    {
+        decltype(input)(arena).swap(input);
+        decltype(adjMat)(arena).swap(adjMat);
+    }
 
+    std::pmr::memory_resource *arena;            // The connection's RequestArena
+    std::shared_ptr<GraphState> graph;           // Graph the session is bound to
+    int choice;                                  // Menu option chosen by the client
+    std::pmr::vector<std::pmr::string> input;    // Raw lines read from the client for this option
+
+    // Filled by the parse stage
+    std::pmr::vector<std::pmr::vector<Weight>> adjMat; // New adjacency matrix (option 1)
+    int from = -1, to = -1;               // Edge arguments (options 2 and 3)
+    Weight weight = 0;
+    int source = -1, end = -1;            // Path endpoints (options 5 and 6)
+    std::vector<std::pair<int, int>> pairs; // Path endpoints of a batch (option 17), read by the session
+
+    // Filled by the MST and query stages
+    std::shared_ptr<MST> mst; // MST of the graph version the request was served from
+    int numVertices = 0;      // Number of vertices of that graph version
+    std::vector<int> path;    // Result of a path query
+    Weight value = 0;         // Result of a weight or distance query
+    PairDistanceStats distances; // Result of the all-pairs query (option 18)
+
+    std::string error;                              // Set by any stage that rejects the request
+    ChunkWriter response;                           // Formatted by the serialize stage, sent by the session
+    std::vector<int> parents;                       // Parent array of option 11
+    std::unique_ptr<BatchSerializer> remaining;     // Rest of a large result (options 8, 10, 11, 17) still to be formatted
+    std::function<void()> onDone;                   // Called by the serialize stage once a batch of the response is ready
+};
+
+/**
+ * Class: Pipeline
+ * Splits request processing into phases, each running on its own ActiveObject:
+ * parse -> graph mutation -> MST construction -> query -> serialize.
+ * Different requests occupy different phases at the same time, so throughput is bound
+ * by the slowest phase rather than by the sum of all of them.
+ */
+class Pipeline
+{
+private:
+    MemoryBudget &budget;     // Charged for the cached MSTs
+    WorkStealingPool workers; // Parallel parts of the MST construction and of batch queries
+    bool chunked;             // Frame streamed results as chunks (--chunked)
+    ActiveObject parseStage, mutateStage, mstStage, queryStage, serializeStage;
+
+    // Requests that failed in some stage skip straight to the serialize stage
+    void fail(std::shared_ptr<Request> req, const std::string &error)
+    {
+        req->error = error;
+        serializeStage.post([this, req]() { serialize(req); });
+    }
+
+    /**
+     * Function: parse
+     * Turns the raw input lines into typed arguments.
+     */
+    void parse(std::shared_ptr<Request> req)
+    {
+        try
+        {
+            switch (req->choice)
+            {
+            case 1:
+            {
+                int numVertices;
+                if (!parseInts(req->input.at(0), &numVertices, 1) || numVertices < 0 ||
+                    static_cast<size_t>(numVertices) + 1 != req->input.size())
+                    return fail(req, "Invalid number of vertices");
+                req->adjMat.assign(numVertices, std::pmr::vector<Weight>(numVertices, 0, req->arena));
+                for (int i = 0; i < numVertices; ++i)
+                {
+                    if (!parseInts(req->input[i + 1], req->adjMat[i].data(), numVertices))
+                        return fail(req, "Row " + std::to_string(i + 1) + " must contain " + std::to_string(numVertices) + " integers");
+                }
+                break;
+            }
+            case 2:
+            {
+                Weight args[3];
+                if (!parseInts(req->input.at(0), args, 3) || args[0] != (int)args[0] || args[1] != (int)args[1])
+                    return fail(req, "Invalid input format! Provide three integers (source, destination, weight).");
+                req->from = args[0];
+                req->to = args[1];
+                req->weight = args[2];
+                break;
+            }
+            case 3:
+            {
+                int args[2];
+                if (!parseInts(req->input.at(0), args, 2))
+                    return fail(req, "Invalid input format! Provide two integers (source, destination).");
+                req->from = args[0];
+                req->to = args[1];
+                break;
+            }
+            case 5:
+            case 6:
+            {
+                int args[2];
+                if (!parseInts(req->input.at(0), args, 2))
+                    return fail(req, "Invalid input format! Provide two integers (source, end).");
+                req->source = args[0];
+                req->end = args[1];
+                break;
+            }
+            default:
+                break;
+            }
+        }
+        catch (const std::exception &e)
+        {
+            return fail(req, std::string("Invalid input: ") + e.what());
+        }
+
+        if (req->choice >= 1 && req->choice <= 3)
+            mutateStage.post([this, req]() { mutate(req); });
+        else
+            mstStage.post([this, req]() { buildMst(req); });
+    }
+
+    /**
+     * Function: mutate
+     * Applies options 1-3 to the request's graph and invalidates its cached MSTs. With --graph a
+     * new graph is saved whole, and an edge change is logged: its response waits for the
+     * log's group commit while the stage goes on with the next mutation. Snapshots are
+     * written from a copy taken under the lock, so the write does not hold the graph.
+     */
+    void mutate(std::shared_ptr<Request> req)
+    {
+        GraphState &state = *req->graph;
+        bool logged = false;
+        GraphStore::CheckpointTicket ticket = 0;
+        Graph snapshot({});
+        try
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            switch (req->choice)
+            {
+            case 1:
+            {
+                FlatMatrix<Weight> matrix(req->adjMat.size(), req->adjMat.size()); // Graph keeps its own copy on the heap, in narrower cells
+                for (size_t i = 0; i < req->adjMat.size(); i++)
+                    std::copy(req->adjMat[i].begin(), req->adjMat[i].end(), matrix[i]);
+                state.graph = Graph(std::move(matrix));
+                state.graph.setnumberofVertices(req->adjMat.size());
+            }
+                break;
+            case 2:
+                state.graph.addEdge(req->from, req->to, req->weight);
+                break;
+            case 3:
+                state.graph.removeEdge(req->from, req->to);
+                break;
+            }
+            state.version++;
+            state.mstCache.clear();
+            state.recharge();
+
+            if (state.store && req->choice != 1)
+            {
+                Mutation mutation{req->choice == 2 ? Mutation::AddEdge : Mutation::RemoveEdge, req->from, req->to, req->weight};
+                state.store->append(mutation, [this, req](bool durable)
+                                    {
+                    if (!durable)
+                        return fail(req, "The change was applied but could not be logged");
+                    serializeStage.post([this, req]() { serialize(req); }); });
+                logged = true;
+            }
+            if (state.store && (req->choice == 1 || state.store->needsCheckpoint()))
+            {
+                ticket = state.store->beginCheckpoint(req->choice == 1);
+                snapshot = state.graph;
+            }
+        }
+        catch (const std::exception &e)
+        {
+            return fail(req, e.what());
+        }
+
+        if (ticket)
+        {
+            try
+            {
+                state.store->checkpoint(snapshot, ticket);
+            }
+            catch (const std::runtime_error &e)
+            {
+                if (!logged)
+                    return fail(req, e.what());
+                std::cerr << e.what() << std::endl; // The log still holds every change
+            }
+        }
+        if (!logged)
+            serializeStage.post([this, req]() { serialize(req); });
+    }
+
+    /**
+     * Function: buildMst
+     * Fetches the MST for the current version of the request's graph from its cache, or builds it.
+     * Only the graph copy is taken under the lock, so mutations are not blocked by the build.
+     * With --graph a cache miss first looks for the MST saved for this graph version, so a
+     * restarted server answers at once, and a built MST is saved once the query is under way.
+     * Cached MSTs are charged to the memory budget, which may evict them again.
+     */
+    void buildMst(std::shared_ptr<Request> req)
+    {
+        MstAlgorithm algorithm = req->choice == 4 ? MstAlgorithm::Kruskal : MstAlgorithm::Boruvka;
+        GraphState &state = *req->graph;
+        Graph snapshot{Matrix()};
+        unsigned long version;
+        GraphVersion savedVersion;
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            req->numVertices = state.graph.getNumVertices();
+            auto cached = state.mstCache.find(algorithm);
+            if (cached != state.mstCache.end() && cached->second.version == state.version)
+            {
+                req->mst = cached->second.mst;
+                cached->second.charge.touch();
+                budget.hit(MemoryKind::Mst);
+                queryStage.post([this, req]() { query(req); });
+                return;
+            }
+            budget.miss(MemoryKind::Mst);
+            version = state.version;
+            if (state.store)
+            {
+                savedVersion = state.store->version();
+                req->mst = state.store->loadMst(algorithm, savedVersion);
+            }
+            if (!req->mst)
+                snapshot = state.graph;
+        }
+
+        bool built = !req->mst;
+        if (built)
+            req->mst = std::make_shared<MST>(snapshot, algorithm, &workers, req->arena);
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            if (version == state.version)
+                state.mstCache.insert_or_assign(algorithm, CachedMst{version, req->mst,
+                                                                     budget.charge(MemoryKind::Mst, {req->mst->treeBytes(), req->mst->indexBytes()},
+                                                                                   evictCachedMst(req->graph, algorithm, version))});
+        }
+        queryStage.post([this, req]() { query(req); });
+        if (built && state.store)
+            state.store->saveMst(*req->mst, algorithm, savedVersion);
+    }
+
+    /**
+     * Function: query
+     * Runs the analytic query of options 4-8, 10, 11 and 18 on the request's MST. The paths of a
+     * batch (option 17) are only checked here and answered as the serialize stage formats them.
+     */
+    void query(std::shared_ptr<Request> req)
+    {
+        if ((req->choice == 5 || req->choice == 6) &&
+            (req->source < 0 || req->source >= req->numVertices || req->end < 0 || req->end >= req->numVertices))
+        {
+            return fail(req, "Vertex index is invalid.");
+        }
+        if (req->choice == 17)
+        {
+            size_t invalid = firstInvalidPair(req->pairs, req->numVertices);
+            if (invalid < req->pairs.size())
+                return fail(req, "Vertex index is invalid in pair " + std::to_string(invalid + 1) + ".");
+        }
+
+        switch (req->choice)
+        {
+        case 4:
+            req->value = req->mst->getWieghtMst();
+            break;
+        case 5:
+            req->path = req->mst->longestPath(req->source, req->end);
+            break;
+        case 6:
+            req->path = req->mst->shortestPath(req->source, req->end);
+            break;
+        case 7:
+            req->value = req->mst->averageDist();
+            break;
+        case 11:
+            req->parents = req->mst->parentArray(0);
+            break;
+        case 18:
+            req->distances = req->mst->pairDistances();
+            break;
+        }
+        serializeStage.post([this, req]() { serialize(req); });
+    }
+
+    /**
+     * Function: serialize
+     * Formats the result of the request and hands it back to the session, which sends it.
+     * Numbers go straight into pooled chunks. Paths, batches of paths and the MST dumps of
+     * options 8, 10 and 11 are streamed: formatted one batch at a time (see serializeMore), so they never exist as
+     * one string, and framed as chunks when the server runs with --chunked.
+     */
+    void serialize(std::shared_ptr<Request> req)
+    {
+        ChunkWriter &out = req->response;
+        if (!req->error.empty())
+        {
+            out.append("Error: ");
+            out.append(req->error);
+            out.append('\n');
+        }
+        else
+        {
+            switch (req->choice)
+            {
+            case 1:
+                out.append("New graph created!\n");
+                break;
+            case 2:
+                out.append("Edge added successfully!\n");
+                break;
+            case 3:
+                out.append("Edge removed successfully!\n");
+                break;
+            case 4:
+                out.append("Total weight of MST: ");
+                out.append(req->value);
+                out.append('\n');
+                break;
+            case 5:
+            case 6:
+                out.setChunked(chunked);
+                out.append(req->choice == 5 ? "Longest" : "Shortest");
+                out.append(" path from ");
+                out.append(req->source);
+                out.append(" to ");
+                out.append(req->end);
+                out.append(": ");
+                req->remaining = std::make_unique<ArraySerializer>(std::move(req->path));
+                break;
+            case 7:
+                out.append("Average distance in MST: ");
+                out.append(req->value);
+                out.append('\n');
+                break;
+            case 8:
+                out.setChunked(chunked);
+                out.append("MST Matrix:\n");
+                req->remaining = std::make_unique<RowSerializer>(req->mst->getNumVertices(), req->mst->getNumVertices(),
+                                                                 [mst = req->mst](size_t u, Weight *row)
+                                                                 { mst->matrixRow(u, row); });
+                break;
+            case 10:
+                out.setChunked(chunked);
+                out.append("MST Edges (u v w):\n");
+                req->remaining = std::make_unique<EdgeListSerializer>(req->mst->edgeList());
+                break;
+            case 11:
+                out.setChunked(chunked);
+                out.append("MST Parent Array:\n");
+                req->remaining = std::make_unique<ArraySerializer>(std::move(req->parents));
+                break;
+            case 17:
+                out.setChunked(chunked);
+                out.append("Paths of ");
+                out.append(static_cast<int64_t>(req->pairs.size()));
+                out.append(" pairs (source end weight: path):\n");
+                req->remaining = std::make_unique<PathBatch>(req->mst, std::move(req->pairs), &workers);
+                break;
+            case 18:
+                out.append(req->distances.report());
+                break;
+            }
+        }
+        serializeBatch(req);
+    }
+
+    // Formats the next batch of a streamed result, ends the stream after the last one,
+    // and hands the batch to the session
+    void serializeBatch(std::shared_ptr<Request> req)
+    {
+        if (req->remaining && !req->remaining->next(req->response, RESPONSE_BATCH))
+            req->response.finish();
+        req->onDone();
+    }
+
+public:
+    Pipeline(const ServerConfig &config, MemoryBudget &budget) : budget(budget), workers(config.threads, config.adaptive), chunked(config.chunked) {}
+
+    // Function: submit
+    // Hands a request to the first stage. Its onDone is called once the response is ready.
+    void submit(std::shared_ptr<Request> req)
+    {
+        parseStage.post([this, req]() { parse(req); });
+    }
+
+    // Function: scheduler
+    // The workers, also for the registry work sessions move off the loop thread
+    WorkStealingPool &scheduler()
+    {
+        return workers;
+    }
+
+    // Function: serializeMore
+    // Formats the next batch of a large result on the serialize stage, then calls onDone again.
+    void serializeMore(std::shared_ptr<Request> req)
+    {
+        serializeStage.post([this, req]() { serializeBatch(req); });
+    }
+};
+
+int listenFd = -1; // Listening socket, shut down by option 0 to stop the accept loop
+ShardedAcceptor *shardedAcceptor = nullptr; // Set while running in --reuseport mode
+EventLoop *eventLoop = nullptr;             // Set while running with --io epoll or uring
 
 /**
  * Function: Menue_process
- * Handles client interaction and requests through a socket. The function interacts with the client
- * by receiving commands, processing them, and sending back responses.
- * This is where the pipeline pattern is implemented using multiple Active Objects for different operations.
+ * Handles the interactive dialogue with one client: it sends the menu and the prompts and
+ * collects the raw input of each option. The processing itself is handed to the pipeline.
+ * The session is a coroutine: on an event loop every send, receive and pipeline round trip
+ * suspends it without holding a thread, so thousands of idle sessions cost only their frames.
  *
- * @param newSocket The socket descriptor for communicating with the client.
- * @param Pointer_Graph A pointer to the Graph object to perform operations on.
+ * @param conn The connection to the client.
+ * @param pipeline The pipeline shared by all client sessions.
+ * @param registry The named graphs; the session starts on the default one.
+ * @param budget The memory budget of the graphs and cached MSTs, for option 16.
  */
-void Menue_process(int newSocket, Graph *Pointer_Graph)
+Session Menue_process(Connection conn, Pipeline &pipeline, GraphRegistry &registry, const MemoryBudget &budget)
 {
-    ActiveObject stage1, stage2, stage3;               // ActiveObject instances to handle stages of the pipeline
-    static MST mst(*Pointer_Graph, "boruvka");              // MST object initialized with the current graph
-    static bool mstCreated = false;                    // Tracks whether the MST has been created
-    bool graphExists = Pointer_Graph->getNumVertices() > 0; // Checks if the graph exists
-
+    RequestArena arena; // Scratch memory of this connection's requests, reset after each response
+    std::string graphName = GraphRegistry::DEFAULT_GRAPH;
+    std::shared_ptr<GraphState> state; // Graph the session is bound to
+    co_await conn.offload(pipeline.scheduler(), [&]()
+                          { state = registry.find(graphName); }); // The registry's file I/O stays off the loop thread
     while (true)
     {
         // Send the menu to the client
-        std::string menu_message =  
+        std::string menu_message =
             "Options:\n"
             "0. Shut down the server\n"
             "1. Initialize a new graph (input adjacency matrix)\n"
@@ -141,318 +582,409 @@ void Menue_process(int newSocket, Graph *Pointer_Graph)
             "6. Find the shortest path in the MST (input: start, end nodes)\n"
             "7. Compute the average edge weight in the MST\n"
             "8. Display the MST (adjacency matrix format)\n"
-            "9. Disconnect from the server\n";;
-        send(newSocket, menu_message.c_str(), menu_message.size(), 0);
+            "9. Disconnect from the server\n"
+            "10. Display the MST as an edge list (u v w per line)\n"
+            "11. Display the MST as a parent array (rooted at vertex 0)\n"
+            "12. Create a named graph and switch to it (input: name)\n"
+            "13. Switch to a named graph (input: name)\n"
+            "14. Drop a named graph (input: name)\n"
+            "15. List the graphs\n"
+            "16. Show memory use and cache statistics\n"
+            "17. Answer a batch of path queries (input: count, then source end pairs)\n"
+            "18. Compute the distance statistics over all pairs of vertices in the MST\n";
+        co_await conn.send(menu_message);
 
         // Read client input
-        char buffer[1024] = {0};
-        ssize_t bytes_read = read(newSocket, buffer, 1024);
-        if (bytes_read <= 0)
+        std::string input;
+        if (!co_await conn.receive(input))
         {
             std::cerr << "" << strerror(errno) << std::endl;
-            close(newSocket);
-            return;
+            conn.close();
+            co_return;
         }
 
-        std::string input(buffer);
         std::istringstream iss(input);
         int choice;
-        iss >> choice;
+        if (!(iss >> choice))
+        {
+            std::string errorMsg = "Invalid input. Please enter a number.\n";
+            co_await conn.send(errorMsg);
+            continue;
+        }
 
-        if (choice != 1 && !graphExists)
+        bool graphExists;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            graphExists = state->graph.getNumVertices() > 0;
+        }
+        if (((choice >= 2 && choice <= 8) || choice == 10 || choice == 11 || choice == 17 || choice == 18) && !graphExists)
         {
             std::string errorMsg = "Please create a graph first using option 1.\n";
-            send(newSocket, errorMsg.c_str(), errorMsg.size(), 0);
+            co_await conn.send(errorMsg);
             continue;
         }
 
+        auto req = std::make_shared<Request>(arena.resource());
+        req->graph = state;
+        req->choice = choice;
+
+        std::string prompt;
         switch (choice)
         {
         case 0:
-        {//close server
-            close(newSocket);
-            close_server=true;
-            return;
-        }    
+        { // Save the graphs and close the server
+            co_await conn.offload(pipeline.scheduler(), [&]()
+                                  { registry.checkpointAll(); });
+            conn.close();
+            close_server = true;
+            shutdown(listenFd, SHUT_RDWR); // Wakes up the accept loop in main
+            if (shardedAcceptor)
+                shardedAcceptor->stop();
+            if (eventLoop)
+                eventLoop->stop();
+            co_return;
+        }
         case 1:
-        { // Create a new graph
+        { // Create a new graph: the row count is needed here to drive the prompts
             std::string response = "Enter the number of vertices: ";
-            send(newSocket, response.c_str(), response.size(), 0);
-
-            char matrixBuffer[1024] = {0};
-            read(newSocket, matrixBuffer, 1024);
-            int numVertices = std::stoi(matrixBuffer);
-
-            std::vector<std::vector<int>> adjMat(numVertices, std::vector<int>(numVertices, 0)); // Empty adjacency matrix
+            co_await conn.send(response);
+            std::string line;
+            if (!co_await conn.receive(line))
+            {
+                conn.close();
+                co_return;
+            }
+            req->input.emplace_back(line.data(), line.size());
 
+            int numVertices = 0;
+            std::istringstream(line) >> numVertices;
             for (int i = 0; i < numVertices; ++i)
             {
                 std::string rowRequest = "Enter row " + std::to_string(i + 1) + " of the adjacency matrix: ";
-                send(newSocket, rowRequest.c_str(), rowRequest.size(), 0);
-
-                char rowBuffer[1024] = {0};
-                read(newSocket, rowBuffer, 1024);
-
-                std::istringstream rowStream(rowBuffer);
-                
-                for (int j = 0; j < numVertices; ++j)
+                co_await conn.send(rowRequest);
+                if (!co_await conn.receive(line))
                 {
-                    int rowStream = std::stoi(matrixBuffer);
-                    rowStream >> adjMat[i][j]; // Fill in the adjacency matrix
+                    conn.close();
+                    co_return;
                 }
+                req->input.emplace_back(line.data(), line.size());
             }
-
-            *Pointer_Graph = Graph(adjMat);
-            Pointer_Graph->setnumberofVertices(numVertices) ;// Create a new graph
-            mstCreated = false;        // Reset the MST flag
-            graphExists = true;        // Mark that the graph exists
-            std::string graphCreatedResponse = "New graph created!\n";
-            send(newSocket, graphCreatedResponse.c_str(), graphCreatedResponse.size(), 0);
             break;
         }
-case 2:
-{
-    std::string addEdgeRequest = "Provide the edge to add (source, destination, weight): ";
-    send(newSocket, addEdgeRequest.c_str(), addEdgeRequest.size(), 0);
-
-    char edgeBuffer[1024] = {0};
-    int bytesRead = read(newSocket, edgeBuffer, sizeof(edgeBuffer) - 1);
-    if (bytesRead > 0) {
-        edgeBuffer[bytesRead] = '\0'; // Null-terminate the string
-
-        std::istringstream edgeStream(edgeBuffer);
-        int from = -1, to = -1, weight = -1;
-
-        if (edgeStream >> from >> to >> weight) {
-            // Debug output
-            std::cout << "Parsed values: Source = " << from
-                      << ", Destination = " << to
-                      << ", Weight = " << weight << std::endl;
-
-            try {
-                stage1.post([&, from, to, weight]()
-                            {
-                                try {
-                                    Pointer_Graph->addEdge(from, to, weight);
-                                    mstCreated = false; // Reset MST flag
-                                    std::string response = "Edge added successfully!\n";
-                                    send(newSocket, response.c_str(), response.size(), 0);
-                                } catch (const std::invalid_argument &e) {
-                                    std::string errorResponse = std::string("Error: ") + e.what() + "\n";
-                                    send(newSocket, errorResponse.c_str(), errorResponse.size(), 0);
-                                }
-                            });
-            } catch (...) {
-                std::cerr << "Exception while posting task to ActiveObject." << std::endl;
-            }
-        } else {
-            std::string errorResponse = "Invalid input format! Provide three integers (source, destination, weight).\n";
-            send(newSocket, errorResponse.c_str(), errorResponse.size(), 0);
-        }
-    } else {
-        std::string errorResponse = "Failed to read input. Please try again.\n";
-        send(newSocket, errorResponse.c_str(), errorResponse.size(), 0);
-    }
-    break;
-}
-
-
-        case 3:
-        { // Remove an edge
-            std::string Remove_edgeRequest = "Provide the edge to remove (source, destination): ";
-            send(newSocket, Remove_edgeRequest.c_str(), Remove_edgeRequest.size(), 0);
-
-            char edgeBuffer[1024] = {0};
-            read(newSocket, edgeBuffer, 1024);
-            std::istringstream edgeStream(edgeBuffer);
-            int from, to;
-            edgeStream >> from >> to;
-
-            stage1.post([&]()
-                        {
-                        Pointer_Graph->removeEdge(from, to);
-                        mstCreated = false; // Reset MST flag
-                        std::string response = "Edge removed successfully!\n";
-                        send(newSocket, response.c_str(), response.size(), 0); });
+        case 2:
+            prompt = "Provide the edge to add (source, destination, weight): ";
             break;
-        }
-        case 4:
-        { // Get MST weight
-            stage2.post([&]()
-                        {
-                       MST mst(*Pointer_Graph, "kruskal"); // Use Kruskal's algorithm to create the MST
-                int weight = mst.getWieghtMst();
-                std::string response = "Total weight of MST: " + std::to_string(weight) + "\n";
-                send(newSocket, response.c_str(), response.size(), 0);
-                        });
+        case 3:
+            prompt = "Provide the edge to remove (source, destination): ";
             break;
-        }
         case 5:
-        { // Get the longest path in the MST
-            std::string Longest_pathRequest = "Provide the source and end vertices for the Longest path ";
-            send(newSocket, Longest_pathRequest.c_str(), Longest_pathRequest.size(), 0);
-            char pathBuffer[1024] = {0};
-            read(newSocket, pathBuffer, 1024); // Read the source and end vertices
-            std::istringstream pathStream(pathBuffer);
-            int source, end;
-            stage3.post([&]()
-                        {
-                    pathStream >> source >> end;
-                        if (!mstCreated) {
-                            mst = MST(*Pointer_Graph, "boruvka"); // Create the MST
-                            mstCreated = true;
-                        }
-                     std::vector<int> path = mst.longestPath(source, end);
-                    std::string response = "Longest path from "+ std::to_string(source) + " to " + std::to_string(end) + ": ";
-                    for (int v : path) {
-                        response += std::to_string(v) + " ";
-                    }
-                    response += "\n";
-                        send(newSocket, response.c_str(), response.size(), 0); });
+            prompt = "Provide the source and end vertices for the Longest path ";
             break;
-        }
         case 6:
-        { // Get the shortest path in the MST
-            std::string Shortest_pathRequest = "Provide the source and end vertices for the shortest path: ";
-            send(newSocket, Shortest_pathRequest.c_str(), Shortest_pathRequest.size(), 0);
-            char pathBuffer[1024] = {0};
-            read(newSocket, pathBuffer, 1024);
-            std::istringstream pathStream(pathBuffer);
-            int source, end;
-            pathStream >> source >> end;
-
-            stage3.post([&]()
-                        {
-                        if (!mstCreated) {
-                            mst = MST(*Pointer_Graph, "boruvka"); // Create the MST
-                            mstCreated = true;
-                        }
-                        auto path = mst.shortestPath(source, end);
-                        std::string response = "Shortest path from " + std::to_string(source) + " to " + std::to_string(end) + ": ";
-                        for (auto& p : path) {
-                            response += std::to_string(p) + " "; // Build path response
-                        }
-                        response += "\n";
-                        send(newSocket, response.c_str(), response.size(), 0); });
+            prompt = "Provide the source and end vertices for the shortest path: ";
             break;
-        }
+        case 4:
         case 7:
-        { // Get the average distance in the MST
-            stage3.post([&]()
-                        {
-                        if (!mstCreated) {
-                            mst = MST(*Pointer_Graph, "boruvka"); // Create the MST
-                            mstCreated = true;
-                        }
-                        int avg = mst.averageDist();
-                        std::string response = "Average distance in MST: " + std::to_string(avg) + "\n";
-                        send(newSocket, response.c_str(), response.size(), 0); });
+        case 8:
+        case 10:
+        case 11:
+        case 18:
+            break;
+        case 9: // Exit the program
+            conn.close();
+            co_return;
+        case 17:
+        { // A batch of path queries: the pairs may take any number of lines and reads
+            std::string response = "Enter the number of pairs: ";
+            co_await conn.send(response);
+            std::string line;
+            if (!co_await conn.receive(line))
+            {
+                conn.close();
+                co_return;
+            }
+            size_t count = 0;
+            if (!parseInts(line, &count, 1) || count == 0 || count > MAX_BATCH_PAIRS)
+            {
+                response = "Error: The number of pairs must be 1 to " + std::to_string(MAX_BATCH_PAIRS) + "\n";
+                co_await conn.send(response);
+                continue;
+            }
+            response = "Provide the pairs (source end), any number per line: ";
+            co_await conn.send(response);
+            PairReader reader(count);
+            bool valid = true;
+            while (valid && !reader.complete())
+            {
+                if (!co_await conn.receive(line))
+                {
+                    conn.close();
+                    co_return;
+                }
+                valid = reader.feed(line);
+            }
+            if (!valid)
+            {
+                response = "Error: Invalid input format! Provide pairs of integers (source, end).\n";
+                co_await conn.send(response);
+                continue;
+            }
+            req->pairs = reader.take();
             break;
         }
-        case 8:
-        { // Print the MST matrix
-            stage3.post([&]()
+        case 12:
+        case 13:
+        case 14:
+        { // Create, select or drop a named graph; the registry does this on the workers, outside the pipeline
+            std::string response = "Enter the graph name: ";
+            co_await conn.send(response);
+            std::string line;
+            if (!co_await conn.receive(line))
+            {
+                conn.close();
+                co_return;
+            }
+            std::string name;
+            std::istringstream(line) >> name;
+            co_await conn.offload(pipeline.scheduler(), [&]()
+                                  {
+                try
+                {
+                    if (choice == 12)
+                    {
+                        state = registry.create(name);
+                        graphName = name;
+                        response = "Graph " + name + " created and selected\n";
+                    }
+                    else if (choice == 13)
+                    {
+                        auto found = registry.find(name);
+                        if (!found)
+                            throw std::invalid_argument("No graph named " + name);
+                        state = std::move(found);
+                        graphName = name;
+                        response = "Graph " + name + " selected\n";
+                    }
+                    else
+                    {
+                        registry.drop(name);
+                        response = "Graph " + name + " dropped\n";
+                        if (name == graphName)
                         {
-                            if (!mstCreated)
-                            {
-                                mst = MST(*Pointer_Graph, "boruvka"); // Create the MST
-                                mstCreated = true;
-                            }
-                            std::stringstream mstStream;   // To build the MST output
-                            auto mstMatrix = mst.getMST(); // Get the MST matrix
-                            for (const auto &row : mstMatrix)
-                            {
-                                for (const auto &val : row)
-                                {
-                                    mstStream << val << " "; // Append each value to the stringstream
-                                }
-                                mstStream << "\n"; // New line after each row
-                            }
-                            std::string mstOutput = "MST Matrix:\n" + mstStream.str(); // Build the final output string
-                            send(newSocket, mstOutput.c_str(), mstOutput.size(), 0);   // Send the MST to the client
-                        });
-            break;
+                            graphName = GraphRegistry::DEFAULT_GRAPH;
+                            state = registry.find(graphName);
+                            response = "Graph " + name + " dropped, back on the default graph\n";
+                        }
+                    }
+                }
+                catch (const std::exception &e)
+                {
+                    response = std::string("Error: ") + e.what() + "\n";
+                } });
+            co_await conn.send(response);
+            continue;
+        }
+        case 15:
+        {
+            std::string response = "Graphs:\n";
+            for (const std::string &name : registry.names())
+                response += name + (name == graphName ? " (selected)\n" : "\n");
+            co_await conn.send(response);
+            continue;
+        }
+        case 16:
+        {
+            std::string response = budget.report();
+            co_await conn.send(response);
+            continue;
         }
-        case 9: // Exit the program
-            close(newSocket);
-            return;
         default: // Invalid choice
+        {
             std::string response = "Invalid choice. Please try again.\n";
-            send(newSocket, response.c_str(), response.size(), 0);
-            break;
+            co_await conn.send(response);
+            continue;
+        }
+        }
+
+        if (!prompt.empty())
+        {
+            co_await conn.send(prompt);
+            std::string line;
+            if (!co_await conn.receive(line))
+            {
+                conn.close();
+                co_return;
+            }
+            req->input.emplace_back(line.data(), line.size());
+        }
+
+        // Suspend until the pipeline has the response, then send it before the next menu.
+        // A large result comes in batches: each one is sent before the next is formatted.
+        co_await conn.handoff([&](std::function<void()> resume)
+                              {
+            req->onDone = std::move(resume);
+            pipeline.submit(req); });
+        bool sent = co_await conn.send(req->response);
+        while (sent && req->remaining && !req->remaining->done())
+        {
+            co_await conn.handoff([&](std::function<void()> resume)
+                                  {
+                req->onDone = std::move(resume);
+                pipeline.serializeMore(req); });
+            sent = co_await conn.send(req->response);
         }
+        req->releaseArena();
+        arena.reset();
     }
 }
 
 /**
  * Main Function: Initializes the server and listens for client connections.
- * The server uses a socket to accept connections and handle multiple clients in parallel.
+ * With blocking I/O every client gets its own session thread; with an event loop the
+ * sessions are coroutines on the loop thread. All sessions feed the same pipeline.
+ * Port, backlog and pool size come from the command line (see serverUsage).
  */
-int main()
+int main(int argc, char *argv[])
 {
-    
-    int serverFd, newSocket;
+    ServerConfig config;
+    try
+    {
+        config = parseServerConfig(argc, argv, ServerConfig{PORT, 3, 0});
+    }
+    catch (const std::invalid_argument &e)
+    {
+        std::cerr << e.what() << "\n" << serverUsage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    MemoryBudget budget(config.memoryBudget); // Declared first: the graphs hold charges of it
+    GraphRegistry registry(config.graphFile, &budget); // Only the empty default graph, unless --graph names saved ones
+    if (!config.graphFile.empty())
+    {
+        try
+        {
+            for (const auto &[name, replayed] : registry.load())
+                std::cout << "Loaded graph " << name << " of " << registry.find(name)->graph.getNumVertices()
+                          << " vertices from " << config.graphFile << " and replayed " << replayed << " logged changes" << std::endl;
+        }
+        catch (const std::runtime_error &e)
+        {
+            std::cerr << e.what() << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    Pipeline pipeline(config, budget);
+
+    if (config.reusePort)
+    {
+        // One listener, event loop and worker set per core; sessions run as coroutines on their shard's loop,
+        // or with blocking I/O on a thread of their own, as without --reuseport
+        try
+        {
+            bool blocking = config.ioBackend == IoBackendKind::Blocking;
+            ShardedAcceptor acceptor(config, [&](int clientSocket, EventLoop &shardLoop, WorkStealingPool &)
+                                     {
+                std::cout << "Accepted new client" << std::endl;
+                if (blocking)
+                {
+                    std::thread([&, clientSocket]()
+                                { Menue_process(Connection(clientSocket), pipeline, registry, budget); })
+                        .detach();
+                    return;
+                }
+                shardLoop.attach(clientSocket);
+                Menue_process(Connection(clientSocket, &shardLoop), pipeline, registry, budget); });
+            shardedAcceptor = &acceptor;
+            std::cout << "Server is running with " << acceptor.shardCount() << " shards. Waiting for clients..." << std::endl;
+            acceptor.run();
+            shardedAcceptor = nullptr;
+        }
+        catch (const std::runtime_error &e)
+        {
+            std::cerr << e.what() << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        return 0;
+    }
+
+    int newSocket;
     struct sockaddr_in address;
     int addrlen = sizeof(address);
     int opt = 1;
 
     // Create socket
-    if ((serverFd = socket(AF_INET, SOCK_STREAM, 0)) == 0)
+    if ((listenFd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
     {
         std::cerr << "Socket creation failed" << std::endl;
         exit(EXIT_FAILURE);
     }
 
     // Allow port reuse
-    if (setsockopt(serverFd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)))
+    if (setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)))
     {
         std::cerr << "setsockopt failed" << std::endl;
-        close(serverFd);
+        close(listenFd);
         exit(EXIT_FAILURE);
     }
 
     address.sin_family = AF_INET;
     address.sin_addr.s_addr = INADDR_ANY;
-    address.sin_port = htons(PORT);
+    address.sin_port = htons(config.port);
 
     // Bind socket
-    if (bind(serverFd, (struct sockaddr *)&address, sizeof(address)) < 0)
+    if (bind(listenFd, (struct sockaddr *)&address, sizeof(address)) < 0)
     {
         std::cerr << "Bind failed: " << strerror(errno) << std::endl;
-        close(serverFd);
+        close(listenFd);
         exit(EXIT_FAILURE);
     }
 
     // source listening
-    if (listen(serverFd, 3) < 0)
+    if (listen(listenFd, config.backlog) < 0)
     {
         std::cerr << "Listen failed: " << strerror(errno) << std::endl;
-        close(serverFd);
+        close(listenFd);
         exit(EXIT_FAILURE);
     }
 
-    // Create an empty graph with an empty adjacency matrix
-    Graph graph{std::vector<std::vector<int>>{}}; // Empty graph
+    if (config.ioBackend != IoBackendKind::Blocking)
+    {
+        // Accepts, socket I/O and the session coroutines of all clients run on one event loop on the main thread
+        EventLoop loop(config.ioBackend);
+        eventLoop = &loop;
+        loop.listen(listenFd, [&](int clientSocket)
+                    {
+            if (clientSocket < 0)
+            {
+                std::cerr << "Accept failed: " << strerror(-clientSocket) << std::endl;
+                return;
+            }
+            std::cout << "Accepted new client" << std::endl;
+            loop.attach(clientSocket);
+            Menue_process(Connection(clientSocket, &loop), pipeline, registry, budget); });
+        std::cout << "Server is running with " << loop.backendName() << " I/O. Waiting for clients..." << std::endl;
+        loop.run();
+        eventLoop = nullptr;
+        close(listenFd);
+        return 0;
+    }
 
     std::cout << "Server is running. Waiting for clients..." << std::endl;
 
-    // Accept clients and handle them
-    while ((newSocket = accept(serverFd, (struct sockaddr *)&address, (socklen_t *)&addrlen)) >= 0)
+    // Accept clients and give each one its own session
+    while ((newSocket = accept(listenFd, (struct sockaddr *)&address, (socklen_t *)&addrlen)) >= 0)
     {
         std::cout << "Accepted new client" << std::endl;
-        Menue_process(newSocket, &graph); // Handle client requests
-        if(close_server)
-        {
-            close(serverFd);
-            return 0;
-        }
+        std::thread([&, newSocket]()
+                    { Menue_process(Connection(newSocket), pipeline, registry, budget); })
+            .detach();
     }
 
-    if (newSocket < 0)
+    if (!close_server)
     {
         std::cerr << "Accept failed: " << strerror(errno) << std::endl;
     }
 
-    close(serverFd);
+    close(listenFd);
     return 0;
 }
@@ -0,0 +1,182 @@
+#include "Serializer.hpp"
+#include <charconv>
+
+using namespace std;
+
+BufferPool &BufferPool::shared()
+{
+    static BufferPool pool;
+    return pool;
+}
+
+string BufferPool::acquire()
+{
+    {
+        lock_guard<mutex> lock(freeMutex);
+        if (!freeBuffers.empty())
+        {
+            string buffer = std::move(freeBuffers.back());
+            freeBuffers.pop_back();
+            buffer.clear();
+            return buffer;
+        }
+    }
+    string buffer;
+    buffer.reserve(CHUNK_SIZE);
+    return buffer;
+}
+
+void BufferPool::release(vector<string> &buffers)
+{
+    lock_guard<mutex> lock(freeMutex);
+    for (auto &buffer : buffers)
+    {
+        if (freeBuffers.size() < MAX_FREE && buffer.capacity() >= CHUNK_SIZE)
+            freeBuffers.push_back(std::move(buffer));
+    }
+    buffers.clear();
+}
+
+ChunkWriter::~ChunkWriter()
+{
+    pool.release(chunks);
+}
+
+string &ChunkWriter::room(size_t bytes)
+{
+    if (chunks.empty() || chunks.back().capacity() - chunks.back().size() < bytes)
+        chunks.push_back(pool.acquire());
+    return chunks.back();
+}
+
+void ChunkWriter::append(string_view text)
+{
+    while (!text.empty())
+    {
+        string &chunk = room(1);
+        size_t n = min(text.size(), chunk.capacity() - chunk.size());
+        chunk.append(text.data(), n);
+        text.remove_prefix(n);
+        buffered += n;
+    }
+}
+
+void ChunkWriter::append(char c)
+{
+    room(1).push_back(c);
+    buffered++;
+}
+
+// Formats value at the end of chunk, which has room for maxDigits more characters
+template <typename Integer>
+static size_t formatInteger(string &chunk, Integer value, size_t maxDigits)
+{
+    size_t used = chunk.size();
+    chunk.resize(used + maxDigits);
+    char *end = to_chars(chunk.data() + used, chunk.data() + used + maxDigits, value).ptr;
+    chunk.resize(end - chunk.data());
+    return chunk.size() - used;
+}
+
+/**
+ * append
+ * Formats an integer in place with std::to_chars, with no locale and no temporary string.
+ *
+ * @param value The integer to format.
+ */
+void ChunkWriter::append(int value)
+{
+    static const size_t MAX_DIGITS = 11; // "-2147483648"
+    buffered += formatInteger(room(MAX_DIGITS), value, MAX_DIGITS);
+}
+
+void ChunkWriter::append(int64_t value)
+{
+    static const size_t MAX_DIGITS = 20; // "-9223372036854775808"
+    buffered += formatInteger(room(MAX_DIGITS), value, MAX_DIGITS);
+}
+
+vector<string> ChunkWriter::take()
+{
+    vector<string> filled;
+    if (chunked && buffered > 0)
+    {
+        char header[24];
+        char *end = to_chars(header, header + 16, buffered, 16).ptr;
+        filled.reserve(chunks.size() + 3);
+        filled.emplace_back(header, end);
+        filled.back() += "\r\n";
+        for (auto &chunk : chunks)
+            filled.push_back(std::move(chunk));
+        filled.emplace_back("\r\n");
+        chunks.clear();
+    }
+    else
+    {
+        filled.swap(chunks);
+    }
+    if (finishing)
+    {
+        filled.emplace_back("0\r\n\r\n");
+        finishing = false;
+        chunked = false;
+    }
+    buffered = 0;
+    return filled;
+}
+
+void ChunkWriter::finish()
+{
+    finishing = chunked;
+}
+
+void ChunkWriter::recycle(vector<string> &sent)
+{
+    pool.release(sent);
+}
+
+bool RowSerializer::next(ChunkWriter &out, size_t budget)
+{
+    while (row < rows && out.size() < budget)
+    {
+        fillRow(row, values.data());
+        for (int64_t value : values)
+        {
+            out.append(value);
+            out.append(' ');
+        }
+        out.append('\n');
+        row++;
+    }
+    return !done();
+}
+
+bool EdgeListSerializer::next(ChunkWriter &out, size_t budget)
+{
+    while (edge < edges.size() && out.size() < budget)
+    {
+        const auto &[u, v, w] = edges[edge++];
+        out.append(u);
+        out.append(' ');
+        out.append(v);
+        out.append(' ');
+        out.append(w);
+        out.append('\n');
+    }
+    return !done();
+}
+
+bool ArraySerializer::next(ChunkWriter &out, size_t budget)
+{
+    while (index < values.size() && out.size() < budget)
+    {
+        out.append(values[index++]);
+        out.append(' ');
+    }
+    if (index == values.size() && !finished)
+    {
+        out.append('\n');
+        finished = true;
+    }
+    return !done();
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+// Bytes a session formats before it sends them; bounds the memory of one response in flight
+static const size_t RESPONSE_BATCH = 256 * 1024;
+
+// this is a class that keeps released text buffers for reuse, so formatting a response
+// does not allocate and grow a fresh string every time
+class BufferPool
+{
+public:
+    static const size_t CHUNK_SIZE = 64 * 1024;
+    static const size_t MAX_FREE = 64; // Buffers kept beyond this are freed
+
+    static BufferPool &shared();
+    std::string acquire(); // Empty buffer with CHUNK_SIZE capacity
+    void release(std::vector<std::string> &buffers);
+
+private:
+    std::mutex freeMutex;
+    std::vector<std::string> freeBuffers;
+};
+
+// this is a class that formats text and numbers straight into pooled chunks with std::to_chars.
+// The filled chunks are taken out as the parts of one vectored send, and come back after it.
+// In chunked mode every batch taken out is framed as one chunk of the chunked transfer coding
+// ("<hex size>\r\n<data>\r\n"), so a client can read a stream of unknown length.
+class ChunkWriter
+{
+public:
+    explicit ChunkWriter(BufferPool &pool = BufferPool::shared()) : pool(pool) {}
+    ~ChunkWriter();
+    ChunkWriter(const ChunkWriter &) = delete;
+    ChunkWriter &operator=(const ChunkWriter &) = delete;
+
+    void append(std::string_view text);
+    void append(char c);
+    void append(int value);
+    void append(int64_t value); // Weights and sums of weights
+    size_t size() const { return buffered; } // Bytes formatted and not yet taken
+    void setChunked(bool on) { chunked = on; }
+    void finish(); // Ends a chunked stream: the next take() also carries the terminating empty chunk
+    std::vector<std::string> take();           // Hands the filled chunks over for sending
+    void recycle(std::vector<std::string> &sent); // Returns sent chunks to the pool
+
+private:
+    BufferPool &pool;
+    std::vector<std::string> chunks;
+    size_t buffered = 0;
+    bool chunked = false;
+    bool finishing = false;
+
+    std::string &room(size_t bytes); // Chunk with at least `bytes` of spare capacity
+};
+
+// this is the interface of the serializers that format a large result a batch at a time,
+// so it never has to exist as one string
+class BatchSerializer
+{
+public:
+    virtual ~BatchSerializer() = default;
+    virtual bool next(ChunkWriter &out, size_t budget) = 0; // Formats until `budget` bytes are buffered; false once everything is out
+    virtual bool done() const = 0;
+};
+
+// this is a class that formats a matrix that is never stored whole: fillRow produces each row
+// just before it is formatted, so only one row exists at a time
+class RowSerializer : public BatchSerializer
+{
+public:
+    RowSerializer(size_t rows, size_t cols, std::function<void(size_t, int64_t *)> fillRow)
+        : rows(rows), values(cols), fillRow(std::move(fillRow)) {}
+    bool next(ChunkWriter &out, size_t budget) override;
+    bool done() const override { return row == rows; }
+
+private:
+    size_t rows;
+    std::vector<int64_t> values; // The current row
+    std::function<void(size_t, int64_t *)> fillRow;
+    size_t row = 0;
+};
+
+// this is a class that formats weighted edges as "u v w" lines
+class EdgeListSerializer : public BatchSerializer
+{
+public:
+    explicit EdgeListSerializer(const std::vector<std::tuple<int, int, int64_t>> &edges) : edges(edges) {}
+    bool next(ChunkWriter &out, size_t budget) override;
+    bool done() const override { return edge == edges.size(); }
+
+private:
+    const std::vector<std::tuple<int, int, int64_t>> &edges;
+    size_t edge = 0;
+};
+
+// this is a class that formats an array as one line of space-separated values
+class ArraySerializer : public BatchSerializer
+{
+public:
+    explicit ArraySerializer(std::vector<int> values) : values(std::move(values)) {}
+    bool next(ChunkWriter &out, size_t budget) override;
+    bool done() const override { return finished; }
+
+private:
+    std::vector<int> values;
+    size_t index = 0;
+    bool finished = false; // Set once the closing newline is out
+};
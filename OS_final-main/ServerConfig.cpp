@@ -0,0 +1,155 @@
+#include "ServerConfig.hpp"
+#include <cctype>
+#include <cstdint>
+#include <getopt.h>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+
+// Parses a positive integer option value, rejecting trailing garbage
+static long parsePositive(const char *name, const char *value)
+{
+    size_t used = 0;
+    long result;
+    try
+    {
+        result = stol(value, &used);
+    }
+    catch (const exception &)
+    {
+        throw invalid_argument(string("Invalid value for --") + name + ": " + value);
+    }
+    if (used != string(value).size() || result <= 0)
+        throw invalid_argument(string("Invalid value for --") + name + ": " + value);
+    return result;
+}
+
+// Parses a size in bytes with an optional K, M or G suffix (powers of 1024)
+static size_t parseSize(const char *name, const char *value)
+{
+    string text(value);
+    size_t scale = 1;
+    if (!text.empty())
+    {
+        switch (toupper(static_cast<unsigned char>(text.back())))
+        {
+        case 'K':
+            scale = size_t(1) << 10;
+            break;
+        case 'M':
+            scale = size_t(1) << 20;
+            break;
+        case 'G':
+            scale = size_t(1) << 30;
+            break;
+        }
+        if (scale > 1)
+            text.pop_back();
+    }
+    size_t count = parsePositive(name, text.c_str());
+    if (count > SIZE_MAX / scale)
+        throw invalid_argument(string("Invalid value for --") + name + ": " + value);
+    return count * scale;
+}
+
+/**
+ * parseServerConfig
+ * Reads the server settings from the command line, starting from the given defaults.
+ * Recognized options: --port/-p, --backlog/-b, --threads/-t, --adaptive/-a, --reuseport/-r,
+ * --io/-i, --chunked/-c, --graph/-g and --memory/-m.
+ *
+ * @param argc The argument count from main.
+ * @param argv The arguments from main.
+ * @param defaults The settings used for options that are not given.
+ * @return The resulting settings, with threads resolved to a concrete count.
+ * @throws invalid_argument on unknown options or invalid values.
+ */
+ServerConfig parseServerConfig(int argc, char *argv[], ServerConfig defaults)
+{
+    static const option longOptions[] = {
+        {"port", required_argument, nullptr, 'p'},
+        {"backlog", required_argument, nullptr, 'b'},
+        {"threads", required_argument, nullptr, 't'},
+        {"adaptive", no_argument, nullptr, 'a'},
+        {"reuseport", no_argument, nullptr, 'r'},
+        {"io", required_argument, nullptr, 'i'},
+        {"chunked", no_argument, nullptr, 'c'},
+        {"graph", required_argument, nullptr, 'g'},
+        {"memory", required_argument, nullptr, 'm'},
+        {nullptr, 0, nullptr, 0}};
+
+    ServerConfig config = defaults;
+    optind = 1;
+    opterr = 0;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "p:b:t:ari:cg:m:", longOptions, nullptr)) != -1)
+    {
+        switch (opt)
+        {
+        case 'p':
+            config.port = parsePositive("port", optarg);
+            if (config.port > 65535)
+                throw invalid_argument("Port must be at most 65535");
+            break;
+        case 'b':
+            config.backlog = parsePositive("backlog", optarg);
+            break;
+        case 't':
+            config.threads = parsePositive("threads", optarg);
+            break;
+        case 'a':
+            config.adaptive = true;
+            break;
+        case 'r':
+            config.reusePort = true;
+            break;
+        case 'i':
+            if (string(optarg) == "blocking")
+                config.ioBackend = IoBackendKind::Blocking;
+            else if (string(optarg) == "epoll")
+                config.ioBackend = IoBackendKind::Epoll;
+            else if (string(optarg) == "uring")
+                config.ioBackend = IoBackendKind::Uring;
+            else
+                throw invalid_argument(string("Invalid value for --io: ") + optarg);
+            break;
+        case 'c':
+            config.chunked = true;
+            break;
+        case 'g':
+            if (*optarg == '\0')
+                throw invalid_argument("Invalid value for --graph: empty path");
+            config.graphFile = optarg;
+            break;
+        case 'm':
+            config.memoryBudget = parseSize("memory", optarg);
+            break;
+        default:
+            throw invalid_argument("Unknown option");
+        }
+    }
+    if (optind < argc)
+        throw invalid_argument(string("Unexpected argument: ") + argv[optind]);
+
+    if (config.threads == 0)
+        config.threads = max(thread::hardware_concurrency(), 1u);
+    return config;
+}
+
+// Function: serverUsage
+// Returns the command line help shown when the options cannot be parsed.
+string serverUsage(const char *program)
+{
+    return string("Usage: ") + program +
+           " [--port N] [--backlog N] [--threads N] [--adaptive] [--reuseport] [--io blocking|epoll|uring] [--chunked] [--graph FILE] [--memory SIZE]\n"
+           "  -p, --port N      port to listen on\n"
+           "  -b, --backlog N   length of the pending-connection queue\n"
+           "  -t, --threads N   initial number of worker threads (default: one per hardware thread)\n"
+           "  -a, --adaptive    grow and shrink the worker set with the load, up to the hardware threads\n"
+           "  -r, --reuseport   one listener, event loop and worker set per core (threads are split over the cores)\n"
+           "  -i, --io KIND     socket I/O: blocking (default), epoll, or uring (falls back to epoll)\n"
+           "  -c, --chunked     send paths and MST dumps as a stream of \"<hex size>\\r\\n<data>\\r\\n\" chunks ending in \"0\\r\\n\\r\\n\"\n"
+           "  -g, --graph FILE  start with the graph saved in FILE (if it exists) and save the graph there on shutdown\n"
+           "  -m, --memory SIZE keep graphs and cached MSTs within SIZE bytes (K, M or G suffix), evicting cold ones\n";
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <string>
+#include "IoBackend.hpp"
+
+// this is a struct that holds the startup settings shared by both servers
+struct ServerConfig
+{
+    int port;              // Port the server listens on
+    int backlog;           // Length of the pending-connection queue passed to listen()
+    size_t threads;        // Initial number of worker threads, 0 means one per hardware thread
+    bool adaptive = false; // Grow and shrink the worker set with the load
+    bool reusePort = false; // One SO_REUSEPORT listener, event loop and worker set per core
+    IoBackendKind ioBackend = IoBackendKind::Blocking; // How sessions talk to their sockets
+    bool chunked = false;   // Frame streamed results (paths and MST dumps) with chunked transfer coding
+    std::string graphFile{}; // Graph loaded at startup and saved at shutdown, empty for none
+    size_t memoryBudget = 0; // Bytes of graphs and cached MSTs to stay within, 0 for no limit
+};
+
+ServerConfig parseServerConfig(int argc, char *argv[], ServerConfig defaults);
+std::string serverUsage(const char *program);
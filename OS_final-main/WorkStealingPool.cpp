@@ -0,0 +1,477 @@
+#include "WorkStealingPool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <pthread.h>
+#include <sched.h>
+
+using namespace std;
+
+thread_local WorkStealingPool *WorkStealingPool::currentPool = nullptr;
+thread_local WorkStealingPool::Worker *WorkStealingPool::currentWorker = nullptr;
+
+bool pinCurrentThread(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+WorkStealingDeque::Array::Array(int64_t capacity)
+    : capacity(capacity), slots(new atomic<Job *>[capacity])
+{
+}
+
+WorkStealingDeque::WorkStealingDeque() : top(0), bottom(0)
+{
+    arrays.emplace_back(new Array(64));
+    array.store(arrays.back().get(), memory_order_relaxed);
+}
+
+WorkStealingDeque::~WorkStealingDeque()
+{
+    // Jobs left behind are never run, only freed
+    Array *a = array.load(memory_order_relaxed);
+    for (int64_t i = top.load(memory_order_relaxed); i < bottom.load(memory_order_relaxed); i++)
+        delete a->get(i);
+}
+
+/**
+ * push
+ * Adds a job at the bottom of the deque, doubling the ring buffer when it is full.
+ *
+ * @param job The job to add; the deque does not take ownership until it is popped or stolen.
+ */
+void WorkStealingDeque::push(Job *job)
+{
+    int64_t b = bottom.load(memory_order_relaxed);
+    int64_t t = top.load(memory_order_acquire);
+    Array *a = array.load(memory_order_relaxed);
+    if (b - t > a->capacity - 1)
+    {
+        Array *bigger = new Array(a->capacity * 2);
+        for (int64_t i = t; i < b; i++)
+            bigger->put(i, a->get(i));
+        arrays.emplace_back(bigger);
+        array.store(bigger, memory_order_release);
+        a = bigger;
+    }
+    a->put(b, job);
+    atomic_thread_fence(memory_order_release);
+    bottom.store(b + 1, memory_order_relaxed);
+}
+
+/**
+ * pop
+ * Takes the most recently pushed job. Only the last remaining job needs a CAS,
+ * since that is the only one a thief can race for.
+ *
+ * @return The job, or nullptr if the deque is empty.
+ */
+WorkStealingDeque::Job *WorkStealingDeque::pop()
+{
+    int64_t b = bottom.load(memory_order_relaxed) - 1;
+    Array *a = array.load(memory_order_relaxed);
+    bottom.store(b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t t = top.load(memory_order_relaxed);
+
+    if (t > b)
+    {
+        bottom.store(b + 1, memory_order_relaxed);
+        return nullptr;
+    }
+    Job *job = a->get(b);
+    if (t == b)
+    {
+        if (!top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+            job = nullptr;
+        bottom.store(b + 1, memory_order_relaxed);
+    }
+    return job;
+}
+
+/**
+ * steal
+ * Takes the oldest job from the top of the deque.
+ *
+ * @return The job, or nullptr if the deque is empty or another thread won the race.
+ */
+WorkStealingDeque::Job *WorkStealingDeque::steal()
+{
+    int64_t t = top.load(memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t b = bottom.load(memory_order_acquire);
+    if (t >= b)
+        return nullptr;
+
+    Array *a = array.load(memory_order_acquire);
+    Job *job = a->get(t);
+    if (!top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+        return nullptr;
+    return job;
+}
+
+bool WorkStealingDeque::empty() const
+{
+    return bottom.load(memory_order_relaxed) <= top.load(memory_order_relaxed);
+}
+
+WorkStealingPool::WorkStealingPool(size_t numWorkers, bool adaptive, int cpu) : cpu(cpu)
+{
+    numWorkers = max<size_t>(numWorkers, 1);
+    maxActive = numWorkers;
+    // Workers pinned to one CPU gain nothing from outnumbering the ones asked for: adaptive
+    // mode only shrinks them, or N pinned shards would grow to N * N threads on N cores
+    if (adaptive && cpu < 0)
+        maxActive = max<size_t>(thread::hardware_concurrency(), 1);
+
+    // All slots exist up front so thieves can scan them without synchronizing with growth
+    for (size_t i = 0; i < max(numWorkers, maxActive); i++)
+    {
+        workers.emplace_back(new Worker());
+        workers.back()->rng.seed(random_device{}() + i);
+    }
+    for (size_t i = 0; i < numWorkers; i++)
+        start(workers[i].get());
+    active = numWorkers;
+
+    if (adaptive)
+        monitor = thread([this]()
+                         { monitorLoop(); });
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        lock_guard<mutex> lock(sleepMutex);
+        stopFlag = true;
+    }
+    cv.notify_all();
+    monitorCv.notify_all();
+    if (monitor.joinable())
+        monitor.join();
+    for (auto &worker : workers)
+    {
+        if (worker->thread.joinable())
+            worker->thread.join();
+    }
+}
+
+// Starts the thread of a slot whose previous thread, if any, has left workerLoop
+void WorkStealingPool::start(Worker *worker)
+{
+    if (worker->thread.joinable())
+        worker->thread.join();
+    worker->retire = false;
+    worker->running = true;
+    worker->thread = thread([this, worker]()
+                            { workerLoop(worker); });
+}
+
+/**
+ * cpuBusyFraction
+ * Reads the aggregate CPU counters from /proc/stat and returns the share of time
+ * spent busy since the previous call.
+ *
+ * @param prevBusy The busy ticks of the previous call, updated in place.
+ * @param prevTotal The total ticks of the previous call, updated in place.
+ * @return The busy fraction in [0, 1], or 0 if the counters are not available.
+ */
+static double cpuBusyFraction(unsigned long long &prevBusy, unsigned long long &prevTotal)
+{
+    ifstream stat("/proc/stat");
+    string cpu;
+    unsigned long long user = 0, nice = 0, system = 0, idle = 0, iowait = 0, irq = 0, softirq = 0, steal = 0;
+    if (!(stat >> cpu >> user >> nice >> system >> idle >> iowait >> irq >> softirq >> steal))
+        return 0;
+
+    unsigned long long busy = user + nice + system + irq + softirq + steal;
+    unsigned long long total = busy + idle + iowait;
+    double fraction = total > prevTotal ? double(busy - prevBusy) / double(total - prevTotal) : 0;
+    prevBusy = busy;
+    prevTotal = total;
+    return fraction;
+}
+
+/**
+ * monitorLoop
+ * Adaptive sizing: adds a worker while tasks queue up faster than they are taken and
+ * the machine has spare CPU, and retires one after the pool has been idle for a while.
+ */
+void WorkStealingPool::monitorLoop()
+{
+    const auto period = chrono::milliseconds(100);
+    const int idleTicksBeforeShrink = 20; // Two seconds without queued work
+    unsigned long long prevBusy = 0, prevTotal = 0;
+    int idleTicks = 0;
+    cpuBusyFraction(prevBusy, prevTotal);
+
+    while (true)
+    {
+        {
+            unique_lock<mutex> lock(sleepMutex);
+            if (monitorCv.wait_for(lock, period, [this]()
+                                   { return stopFlag.load(); }))
+                return;
+        }
+
+        size_t n = active.load();
+        size_t queued = pending.load();
+        double busy = cpuBusyFraction(prevBusy, prevTotal);
+
+        if (queued > 0 && sleeping.load() == 0 && busy < 0.9 && n < maxActive)
+        {
+            Worker *worker = workers[n].get();
+            if (worker->running)
+                worker->retire = false; // Still draining after an earlier shrink, just keep it
+            else
+                start(worker);
+            active = n + 1;
+            idleTicks = 0;
+        }
+        else if (queued == 0 && sleeping.load() > 1 && n > 1)
+        {
+            if (++idleTicks >= idleTicksBeforeShrink)
+            {
+                active = n - 1;
+                {
+                    lock_guard<mutex> lock(sleepMutex);
+                    workers[n - 1]->retire = true;
+                }
+                cv.notify_all();
+                idleTicks = 0;
+            }
+        }
+        else
+        {
+            idleTicks = 0;
+        }
+    }
+}
+
+/**
+ * submit
+ * Queues a task. Tasks spawned by a worker go to the bottom of its own deque so they run
+ * hot in its cache; tasks from other threads are spread round robin over the inboxes.
+ *
+ * @param task The task to run.
+ */
+void WorkStealingPool::submit(function<void()> task)
+{
+    auto *job = new WorkStealingDeque::Job(std::move(task));
+    pending++;
+    if (currentPool == this)
+    {
+        currentWorker->deque.push(job);
+    }
+    else
+    {
+        Worker *target = workers[nextInbox++ % max<size_t>(active.load(), 1)].get();
+        lock_guard<mutex> lock(target->inboxMutex);
+        target->inbox.push_back(job);
+    }
+    wake();
+}
+
+// Wakes one sleeping worker, if there is any
+void WorkStealingPool::wake()
+{
+    if (sleeping.load() > 0)
+    {
+        lock_guard<mutex> lock(sleepMutex);
+        cv.notify_one();
+    }
+}
+
+/**
+ * take
+ * Finds the next job for a worker: its own deque first, then its inbox,
+ * then the deques and inboxes of the other workers starting at a random victim.
+ *
+ * @param self The worker looking for a job.
+ * @return The job, or nullptr if nothing could be found.
+ */
+WorkStealingDeque::Job *WorkStealingPool::take(Worker *self)
+{
+    WorkStealingDeque::Job *job = self->deque.pop();
+    if (!job)
+    {
+        lock_guard<mutex> lock(self->inboxMutex);
+        if (!self->inbox.empty())
+        {
+            job = self->inbox.front();
+            self->inbox.pop_front();
+        }
+    }
+
+    size_t n = workers.size();
+    size_t first = self->rng() % n;
+    for (size_t k = 0; !job && k < n; k++)
+    {
+        Worker *victim = workers[(first + k) % n].get();
+        if (victim == self)
+            continue;
+        job = victim->deque.steal();
+        if (!job)
+        {
+            unique_lock<mutex> lock(victim->inboxMutex, try_to_lock);
+            if (lock.owns_lock() && !victim->inbox.empty())
+            {
+                job = victim->inbox.front();
+                victim->inbox.pop_front();
+            }
+        }
+    }
+
+    if (job)
+        pending--;
+    return job;
+}
+
+// Runs one queued job on the calling worker
+bool WorkStealingPool::runOne()
+{
+    WorkStealingDeque::Job *job = take(currentWorker);
+    if (!job)
+        return false;
+    try
+    {
+        (*job)();
+    }
+    catch (const exception &e)
+    {
+        cerr << "Exception in WorkStealingPool task: " << e.what() << endl;
+    }
+    delete job;
+    return true;
+}
+
+void WorkStealingPool::workerLoop(Worker *self)
+{
+    if (cpu >= 0)
+        pinCurrentThread(cpu);
+    currentPool = this;
+    currentWorker = self;
+    while (true)
+    {
+        if (runOne())
+            continue;
+        if (self->retire)
+            break;
+
+        unique_lock<mutex> lock(sleepMutex);
+        sleeping++;
+        cv.wait(lock, [this, self]()
+                { return pending.load() > 0 || stopFlag || self->retire; });
+        sleeping--;
+        if (stopFlag && pending.load() == 0)
+            break;
+    }
+    self->running = false;
+}
+
+/**
+ * parallelFor
+ * Splits [begin, end) into chunks of grain indices and runs body on every chunk.
+ * The calling thread takes chunks until none are left, so it only ever waits for chunks
+ * other threads are running, and nested calls from inside pool tasks cannot deadlock.
+ * While it waits it runs no other jobs: a queued job may be a whole client session.
+ * If body throws, the chunks not yet started are skipped and the first exception is
+ * rethrown on the caller once every running chunk has finished.
+ *
+ * @param begin The first index.
+ * @param end One past the last index.
+ * @param grain The number of indices per chunk.
+ * @param body Called as body(lo, hi) for every chunk.
+ */
+void WorkStealingPool::parallelFor(size_t begin, size_t end, size_t grain, const function<void(size_t, size_t)> &body)
+{
+    if (end <= begin)
+        return;
+    grain = max<size_t>(grain, 1);
+    size_t chunks = (end - begin + grain - 1) / grain;
+    if (chunks == 1)
+    {
+        body(begin, end);
+        return;
+    }
+
+    struct State
+    {
+        atomic<size_t> next{0};
+        atomic<size_t> done{0};
+        size_t chunks, begin, end, grain;
+        function<void(size_t, size_t)> body;
+        mutex doneMutex;
+        condition_variable doneCv;
+        atomic<bool> failed{false};
+        exception_ptr error; // The first exception of body, set under doneMutex
+    };
+    auto state = make_shared<State>();
+    state->chunks = chunks;
+    state->begin = begin;
+    state->end = end;
+    state->grain = grain;
+    state->body = body;
+
+    auto work = [state]()
+    {
+        // Counts the chunk as done however body leaves it, so the caller never waits forever
+        struct ChunkDone
+        {
+            State &state;
+            ~ChunkDone()
+            {
+                if (state.done.fetch_add(1) + 1 == state.chunks)
+                {
+                    lock_guard<mutex> lock(state.doneMutex);
+                    state.doneCv.notify_all();
+                }
+            }
+        };
+        size_t c;
+        while ((c = state->next.fetch_add(1)) < state->chunks)
+        {
+            ChunkDone chunkDone{*state};
+            if (state->failed.load())
+                continue;
+            size_t lo = state->begin + c * state->grain;
+            size_t hi = min(state->end, lo + state->grain);
+            try
+            {
+                state->body(lo, hi);
+            }
+            catch (...)
+            {
+                lock_guard<mutex> lock(state->doneMutex);
+                if (!state->error)
+                    state->error = current_exception();
+                state->failed = true;
+            }
+        }
+    };
+
+    size_t helpers = min(chunks - 1, size());
+    for (size_t i = 0; i < helpers; i++)
+        submit(work);
+    work();
+
+    {
+        unique_lock<mutex> lock(state->doneMutex);
+        state->doneCv.wait(lock, [&]()
+                           { return state->done.load() == chunks; });
+    }
+    if (state->failed.load())
+    {
+        exception_ptr error;
+        {
+            lock_guard<mutex> lock(state->doneMutex);
+            error = state->error;
+        }
+        rethrow_exception(error);
+    }
+}
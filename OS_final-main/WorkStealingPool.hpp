@@ -0,0 +1,93 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Pins the calling thread to one CPU; returns false if the kernel refused
+bool pinCurrentThread(int cpu);
+
+// this is a Chase-Lev deque: the owning worker pushes and pops at the bottom without locks,
+// other workers steal from the top with a single CAS
+class WorkStealingDeque
+{
+public:
+    using Job = std::function<void()>;
+
+    WorkStealingDeque();
+    ~WorkStealingDeque();
+    void push(Job *job); // owner only
+    Job *pop();          // owner only
+    Job *steal();        // any thread
+    bool empty() const;
+
+private:
+    struct Array
+    {
+        int64_t capacity;
+        std::unique_ptr<std::atomic<Job *>[]> slots;
+        explicit Array(int64_t capacity);
+        Job *get(int64_t i) const { return slots[i & (capacity - 1)].load(std::memory_order_relaxed); }
+        void put(int64_t i, Job *job) { slots[i & (capacity - 1)].store(job, std::memory_order_relaxed); }
+    };
+
+    std::atomic<int64_t> top;
+    std::atomic<int64_t> bottom;
+    std::atomic<Array *> array;
+    std::vector<std::unique_ptr<Array>> arrays; // every array ever used, freed on destruction since thieves may still read old ones
+};
+
+// this is a thread pool where every worker owns a deque and idle workers steal from random victims.
+// In adaptive mode a monitor thread grows and shrinks the worker set between 1 and the number
+// of hardware threads (between 1 and numWorkers for a pool pinned to one CPU), following the
+// queue depth and the CPU utilization.
+class WorkStealingPool
+{
+public:
+    explicit WorkStealingPool(size_t numWorkers, bool adaptive = false, int cpu = -1);
+    ~WorkStealingPool();
+    void submit(std::function<void()> task);
+    void parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)> &body);
+    size_t size() const { return active.load(); }
+
+private:
+    struct Worker
+    {
+        WorkStealingDeque deque;                 // Tasks spawned by this worker
+        std::mutex inboxMutex;                   // Protects inbox
+        std::deque<std::function<void()> *> inbox; // Tasks submitted from outside the pool
+        std::mt19937 rng;                        // Victim selection
+        std::atomic<bool> retire{false};         // Set by the monitor to make the worker exit once idle
+        std::atomic<bool> running{false};        // True while the thread is inside workerLoop
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers; // Fixed capacity; only the first `active` ones get new work
+    std::atomic<size_t> active{0};
+    size_t maxActive = 0;                         // Adaptive mode never grows beyond this
+    int cpu = -1;                                 // CPU every worker is pinned to, -1 for no pinning
+    std::thread monitor;                          // Adaptive sizing thread, if enabled
+    std::condition_variable monitorCv;            // Wakes the monitor early on shutdown
+    std::atomic<size_t> nextInbox{0};  // Round robin over the inboxes for outside submissions
+    std::atomic<size_t> pending{0};    // Tasks queued but not yet taken
+    std::atomic<size_t> sleeping{0};   // Workers blocked on cv
+    std::atomic<bool> stopFlag{false};
+    std::mutex sleepMutex;
+    std::condition_variable cv;
+
+    static thread_local WorkStealingPool *currentPool;
+    static thread_local Worker *currentWorker;
+
+    void start(Worker *worker);
+    void monitorLoop();
+    void workerLoop(Worker *self);
+    WorkStealingDeque::Job *take(Worker *self);
+    bool runOne();
+    void wake();
+};